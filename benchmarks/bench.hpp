@@ -0,0 +1,398 @@
+/*
+ * Copyright 2016 Stoned Xander
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HEADLESS_LOGIC_BENCHMARK
+#define HEADLESS_LOGIC_BENCHMARK
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#define BENCH_REPETITIONS 10
+#define BENCH_WARMUP 2
+#define BENCH_TOLERANCE 0.1
+
+namespace Bench {
+
+    /**
+     * Keep a value alive, so that the computation producing it is not
+     * optimized away.
+     * @param value Any result of the measured code.
+     */
+    template <typename T> inline void consume(const T& value) {
+        static volatile T sink;
+        sink = value;
+        (void) sink;
+    }
+
+    /**
+     * Quote a string for JSON.
+     * @param text Raw string.
+     * @return The string, in double quotes, with quotes, backslashes and
+     * control characters escaped.
+     */
+    inline std::string quote(const std::string& text) {
+        static const char hexadecimal[] = "0123456789abcdef";
+        std::string result("\"");
+        for(char c : text) {
+            unsigned char code = static_cast<unsigned char>(c);
+            if(c == '"' || c == '\\') {
+                result += '\\';
+                result += c;
+            } else if(code < 0x20) {
+                result += "\\u00";
+                result += hexadecimal[code >> 4];
+                result += hexadecimal[code & 0xF];
+            } else {
+                result += c;
+            }
+        }
+        return result + '"';
+    }
+
+    /**
+     * Read a string written by 'quote'.
+     * @param text Text holding the quoted string.
+     * @param start Position after the opening quote.
+     * @param result Raw string.
+     * @return false if the closing quote is missing.
+     */
+    inline bool unquote(const std::string& text, std::size_t start, std::string& result) {
+        result.clear();
+        for(std::size_t i = start; i < text.size(); ++i) {
+            if(text[i] == '"') {
+                return true;
+            }
+            if(text[i] != '\\' || i + 1 >= text.size()) {
+                result += text[i];
+            } else if(text[++i] == 'u' && i + 4 < text.size()) {
+                result += static_cast<char>(std::strtoul(text.substr(i + 1, 4).c_str(), nullptr, 16));
+                i += 4;
+            } else {
+                result += text[i];
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Run options, read from the command line.
+     */
+    class Options {
+        public:
+            Options() : repetitions(BENCH_REPETITIONS), warmup(BENCH_WARMUP),
+                tolerance(BENCH_TOLERANCE), quick(false), list(false) {}
+
+            /**
+             * Parse the command line.
+             * @return false on an unknown or incomplete option.
+             */
+            bool parse(int argc, char **argv) {
+                for(int i = 1; i < argc; ++i) {
+                    std::string option(argv[i]);
+                    bool valued = i + 1 < argc;
+                    if(option == "--quick") {
+                        quick = true;
+                    } else if(option == "--list") {
+                        list = true;
+                    } else if(valued && option == "--filter") {
+                        filter = argv[++i];
+                    } else if(valued && option == "--repetitions") {
+                        repetitions = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+                    } else if(valued && option == "--warmup") {
+                        warmup = std::strtoul(argv[++i], nullptr, 10);
+                    } else if(valued && option == "--json") {
+                        json = argv[++i];
+                    } else if(valued && option == "--baseline") {
+                        baseline = argv[++i];
+                    } else if(valued && option == "--tolerance") {
+                        tolerance = std::strtod(argv[++i], nullptr);
+                    } else {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            static void usage(std::ostream& out) {
+                out << "Usage: benchmark [--filter substring] [--repetitions n] [--warmup n]" << std::endl
+                    << "                 [--json file] [--baseline file [--tolerance ratio]]" << std::endl
+                    << "                 [--quick] [--list]" << std::endl;
+            }
+
+        public:
+            /** Timed runs per benchmark. */
+            unsigned long repetitions;
+            /** Untimed runs before the timed ones. */
+            unsigned long warmup;
+            /** Only benchmarks whose name contains it are run. */
+            std::string filter;
+            /** JSON report path, "-" for the standard output. */
+            std::string json;
+            /** JSON report to compare with. */
+            std::string baseline;
+            /** Accepted median slowdown, as a ratio, before reporting a regression. */
+            double tolerance;
+            /** Smaller problem sizes, for smoke runs. */
+            bool quick;
+            /** Only print the benchmark names. */
+            bool list;
+    };
+
+    /**
+     * Statistics of a benchmark, in nanoseconds per operation.
+     */
+    class Result {
+        public:
+            std::string name;
+            /** Operations per repetition. */
+            unsigned long operations;
+            unsigned long repetitions;
+            double min;
+            double p50;
+            double p90;
+            double p99;
+            double max;
+            double mean;
+            double stddev;
+
+            /**
+             * @return Operations per second, from the median.
+             */
+            double rate() const { return p50 > 0.0 ? 1e9 / p50 : 0.0; }
+    };
+
+    /**
+     * Percentile of sorted samples, linearly interpolated.
+     * @param samples Sorted samples, not empty.
+     * @param ratio Percentile, in [0;1].
+     */
+    inline double percentile(const std::vector<double>& samples, double ratio) {
+        double position = ratio * (samples.size() - 1);
+        std::size_t index = static_cast<std::size_t>(position);
+        if(index + 1 >= samples.size()) {
+            return samples.back();
+        }
+        double fraction = position - index;
+        return samples[index] + fraction * (samples[index + 1] - samples[index]);
+    }
+
+    /**
+     * Benchmark runner. Benchmarks are run as they are declared, and
+     * their results kept for the reports.
+     */
+    class Runner {
+        public:
+            Runner(const Options& options) : _options(options) {}
+
+            /**
+             * @return Whether a benchmark is selected by the filter.
+             */
+            bool enabled(const std::string& name) const {
+                return name.find(_options.filter) != std::string::npos;
+            }
+
+            /**
+             * @return true for the reduced problem sizes.
+             */
+            bool quick() const { return _options.quick; }
+
+            /**
+             * Measure a benchmark. The body is run 'warmup' times, then
+             * 'repetitions' timed times, each run being preceded by an
+             * untimed call to 'prepare'.
+             * @param <B> Body, performing 'operations' operations: void operator()().
+             * @param <P> Preparation: void operator()().
+             * @param name Benchmark name, as "module/operation/parameters".
+             * @param operations Number of operations performed by one run of the body.
+             * @param body Measured code.
+             * @param prepare Setup of the next run, e.g. emptying a container.
+             */
+            template <typename B, typename P> void measure(const std::string& name,
+                    unsigned long operations, B body, P prepare) {
+                if(!enabled(name)) {
+                    return;
+                }
+                if(_options.list) {
+                    std::cout << name << std::endl;
+                    return;
+                }
+                for(unsigned long i = 0; i < _options.warmup; ++i) {
+                    prepare();
+                    body();
+                }
+                std::vector<double> samples;
+                for(unsigned long i = 0; i < _options.repetitions; ++i) {
+                    prepare();
+                    auto start = std::chrono::steady_clock::now();
+                    body();
+                    auto end = std::chrono::steady_clock::now();
+                    samples.push_back(std::chrono::duration<double, std::nano>(end - start).count()
+                            / operations);
+                }
+                _results.push_back(summarize(name, operations, samples));
+                print(std::cerr, _results.back());
+            }
+
+            template <typename B> void measure(const std::string& name,
+                    unsigned long operations, B body) {
+                measure(name, operations, body, []() {});
+            }
+
+            const std::vector<Result>& results() const { return _results; }
+
+            /**
+             * Write the results as JSON.
+             * @param out Output stream.
+             */
+            void json(std::ostream& out) const {
+                out << "{" << std::endl << "  \"unit\": \"ns/op\"," << std::endl
+                    << "  \"repetitions\": " << _options.repetitions << "," << std::endl
+                    << "  \"warmup\": " << _options.warmup << "," << std::endl
+                    << "  \"quick\": " << (_options.quick ? "true" : "false") << "," << std::endl
+                    << "  \"benchmarks\": [" << std::endl;
+                out << std::setprecision(6);
+                for(std::size_t i = 0; i < _results.size(); ++i) {
+                    const Result& r = _results[i];
+                    out << "    {\"name\": " << quote(r.name) << ", \"operations\": " << r.operations
+                        << ", \"min\": " << r.min << ", \"p50\": " << r.p50
+                        << ", \"p90\": " << r.p90 << ", \"p99\": " << r.p99
+                        << ", \"max\": " << r.max << ", \"mean\": " << r.mean
+                        << ", \"stddev\": " << r.stddev << ", \"rate\": " << r.rate() << "}"
+                        << (i + 1 < _results.size() ? "," : "") << std::endl;
+                }
+                out << "  ]" << std::endl << "}" << std::endl;
+            }
+
+            /**
+             * Compare the medians with a baseline report.
+             * @param baseline Medians of the baseline, by name.
+             * @param out Output stream.
+             * @return Number of regressions.
+             */
+            unsigned int compare(const std::map<std::string, double>& baseline, std::ostream& out) const {
+                unsigned int regressions = 0;
+                std::ios_base::fmtflags flags = out.flags();
+                std::streamsize precision = out.precision(1);
+                out << std::fixed << std::left << std::setw(56) << "Benchmark" << std::right
+                    << std::setw(14) << "Baseline" << std::setw(14) << "Current"
+                    << std::setw(10) << "Change" << std::endl;
+                for(const Result& r : _results) {
+                    out << std::left << std::setw(56) << r.name << std::right;
+                    auto found = baseline.find(r.name);
+                    if(found == baseline.end() || found->second <= 0.0) {
+                        out << std::setw(14) << "-" << std::setw(14) << r.p50 << "  (new)" << std::endl;
+                        continue;
+                    }
+                    double change = r.p50 / found->second - 1.0;
+                    bool regressed = change > _options.tolerance;
+                    regressions += regressed ? 1 : 0;
+                    out << std::setw(14) << found->second << std::setw(14) << r.p50
+                        << std::setw(9) << change * 100.0 << "%"
+                        << (regressed ? "  REGRESSION" : "") << std::endl;
+                }
+                out.flags(flags);
+                out.precision(precision);
+                return regressions;
+            }
+
+        private:
+            static Result summarize(const std::string& name, unsigned long operations,
+                    std::vector<double>& samples) {
+                std::sort(samples.begin(), samples.end());
+                Result result;
+                result.name = name;
+                result.operations = operations;
+                result.repetitions = samples.size();
+                result.min = samples.front();
+                result.max = samples.back();
+                result.p50 = percentile(samples, 0.5);
+                result.p90 = percentile(samples, 0.9);
+                result.p99 = percentile(samples, 0.99);
+                double sum = 0.0;
+                for(double sample : samples) {
+                    sum += sample;
+                }
+                result.mean = sum / samples.size();
+                double deviation = 0.0;
+                for(double sample : samples) {
+                    deviation += (sample - result.mean) * (sample - result.mean);
+                }
+                result.stddev = std::sqrt(deviation / samples.size());
+                return result;
+            }
+
+            static void print(std::ostream& out, const Result& r) {
+                std::ios_base::fmtflags flags = out.flags();
+                std::streamsize precision = out.precision(1);
+                out << std::fixed << std::left << std::setw(56) << r.name << std::right
+                    << std::setw(12) << r.p50 << " ns/op  p90 "
+                    << std::setw(10) << r.p90 << "  +/- " << std::setw(8) << r.stddev
+                    << std::setprecision(0) << std::setw(14) << r.rate() << " op/s" << std::endl;
+                out.flags(flags);
+                out.precision(precision);
+            }
+
+        private:
+            Options _options;
+            std::vector<Result> _results;
+    };
+
+    /**
+     * Read the medians of a report written by 'Runner::json'. This is not
+     * a general JSON parser: it expects one benchmark object per line.
+     * @param path Report path.
+     * @param medians Medians, by benchmark name.
+     * @return false if the file can't be read.
+     */
+    inline bool load(const std::string& path, std::map<std::string, double>& medians) {
+        std::ifstream in(path.c_str());
+        if(!in) {
+            return false;
+        }
+        const std::string name("\"name\": \"");
+        const std::string median("\"p50\": ");
+        std::string line;
+        std::string key;
+        while(std::getline(in, line)) {
+            std::size_t start = line.find(name);
+            std::size_t value = line.find(median);
+            if(start == std::string::npos || value == std::string::npos ||
+                    !unquote(line, start + name.size(), key)) {
+                continue;
+            }
+            medians[key] = std::strtod(line.c_str() + value + median.size(), nullptr);
+        }
+        return true;
+    }
+
+    /**
+     * Benchmark suites, one per module.
+     */
+    void searchTree(Runner& runner);
+    void flock(Runner& runner);
+    void geneticAlgorithm(Runner& runner);
+    void neuralNetwork(Runner& runner);
+
+} // Namespace 'Bench'
+
+#endif
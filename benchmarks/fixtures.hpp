@@ -0,0 +1,275 @@
+/*
+ * Copyright 2016 Stoned Xander
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HEADLESS_LOGIC_BENCHMARK_FIXTURES
+#define HEADLESS_LOGIC_BENCHMARK_FIXTURES
+
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+ * Dependency-free concepts for the search tree and swarm benchmarks.
+ * They mirror the examples' 'common.hpp' without glm.
+ */
+
+#define FIXTURE_AREA_SIZE 1000.0f
+#define FIXTURE_CLUSTERS 8
+#define FIXTURE_CLUSTER_SPREAD 20.0f
+
+namespace Bench {
+
+    /**
+     * Two dimensional key, also used as a velocity.
+     */
+    class Vec2 {
+        public:
+            Vec2() : x(0.0f), y(0.0f) {}
+            Vec2(float px, float py) : x(px), y(py) {}
+            Vec2 operator+(const Vec2& o) const { return Vec2(x + o.x, y + o.y); }
+            Vec2 operator-(const Vec2& o) const { return Vec2(x - o.x, y - o.y); }
+            Vec2 operator*(double s) const { return Vec2(x * s, y * s); }
+            Vec2& operator+=(const Vec2& o) { x += o.x; y += o.y; return *this; }
+        public:
+            float x;
+            float y;
+    };
+
+    /**
+     * Axis aligned box, split in four quadrants.
+     */
+    class Box {
+        public:
+            static const unsigned int FANOUT = 4;
+            Box() : _x(0.0f), _y(0.0f), _w(0.0f), _h(0.0f) {}
+            Box(float x, float y, float w, float h) : _x(x), _y(y), _w(w), _h(h) {}
+
+            unsigned int dimension() const { return FANOUT; }
+
+            const Box *divide() const {
+                Box *result = new Box[FANOUT];
+                divide(result);
+                return result;
+            }
+
+            void divide(Box *quadrants) const {
+                float w = _w / 2.0f;
+                float h = _h / 2.0f;
+                quadrants[0] = Box(_x, _y, w, h);
+                quadrants[1] = Box(_x + w, _y, w, h);
+                quadrants[2] = Box(_x + w, _y + h, w, h);
+                quadrants[3] = Box(_x, _y + h, w, h);
+            }
+
+            unsigned int index(const Vec2& key) const {
+                // Same edges as 'divide' and 'contains': sub-regions 2 and 3 are reversed.
+                float x = _x + _w / 2.0f;
+                float y = _y + _h / 2.0f;
+                return key.y > y ? (key.x >= x ? 2 : 3) : (key.x > x ? 1 : 0);
+            }
+
+            unsigned long long code(const Vec2& key, unsigned int depth) const {
+                float x = _x;
+                float y = _y;
+                float w = _w;
+                float h = _h;
+                unsigned long long result = 0;
+                for(unsigned int i = 0; i < depth; ++i) {
+                    w /= 2.0f;
+                    h /= 2.0f;
+                    unsigned int down = key.y > y + h;
+                    unsigned int right = down ? key.x >= x + w : key.x > x + w;
+                    x = right ? x + w : x;
+                    y = down ? y + h : y;
+                    result = (result << 2) | (down << 1) | (right ^ down);
+                }
+                return result;
+            }
+
+            bool contains(const Vec2& key) const {
+                return key.x >= _x && key.x <= _x + _w && key.y >= _y && key.y <= _y + _h;
+            }
+
+            int contains(const Box& o) const {
+                bool overlap = _x <= o._x + o._w && _x + _w >= o._x &&
+                    _y <= o._y + o._h && _y + _h >= o._y;
+                if(!overlap) {
+                    return -1;
+                }
+                return o._x >= _x && o._y >= _y && o._x + o._w <= _x + _w &&
+                    o._y + o._h <= _y + _h ? 1 : 0;
+            }
+
+            double distance(const Vec2& key) const {
+                double dx = key.x < _x ? _x - key.x : (key.x > _x + _w ? key.x - (_x + _w) : 0.0);
+                double dy = key.y < _y ? _y - key.y : (key.y > _y + _h ? key.y - (_y + _h) : 0.0);
+                return std::sqrt(dx * dx + dy * dy);
+            }
+
+            float x() const { return _x; }
+            float y() const { return _y; }
+            float width() const { return _w; }
+            float height() const { return _h; }
+        private:
+            float _x;
+            float _y;
+            float _w;
+            float _h;
+    };
+
+    /**
+     * Disc search function and perception tool.
+     */
+    class Disc {
+        public:
+            Disc() : _radius(0.0), _sqradius(0.0) {}
+            Disc(const Vec2& center, double radius) : _center(center) { this->radius(radius); }
+
+            void center(const Vec2& center) { _center = center; }
+            double radius() const { return _radius; }
+            void radius(double radius) {
+                _radius = radius;
+                _sqradius = radius * radius;
+            }
+
+            bool contains(const Vec2& key) const {
+                double dx = key.x - _center.x;
+                double dy = key.y - _center.y;
+                return dx * dx + dy * dy <= _sqradius;
+            }
+
+            void contains(const Vec2 *keys, unsigned int count, unsigned char *mask) const {
+                for(unsigned int i = 0; i < count; ++i) {
+                    double dx = keys[i].x - _center.x;
+                    double dy = keys[i].y - _center.y;
+                    mask[i] = dx * dx + dy * dy <= _sqradius;
+                }
+            }
+
+            int contains(const Box& box) const {
+                // Bounding box overlap only, no full containment test.
+                return box.x() - _radius <= _center.x && box.x() + box.width() + _radius >= _center.x &&
+                    box.y() - _radius <= _center.y && box.y() + box.height() + _radius >= _center.y ? 0 : -1;
+            }
+        private:
+            Vec2 _center;
+            double _radius;
+            double _sqradius;
+    };
+
+    class Euclidean {
+        public:
+            double distance(const Vec2& a, const Vec2& b) const {
+                double dx = a.x - b.x;
+                double dy = a.y - b.y;
+                return std::sqrt(dx * dx + dy * dy);
+            }
+    };
+
+    /**
+     * Tree element and swarm agent.
+     */
+    class Agent {
+        public:
+            Agent(const Vec2& key, double radius) : _key(key), _detector(key, radius) {}
+            const Vec2& key() const { return _key; }
+            void key(const Vec2& key) {
+                _key = key;
+                _detector.center(key);
+            }
+            const Vec2& velocity() const { return _velocity; }
+            void velocity(const Vec2& velocity) { _velocity = velocity; }
+            const Disc& detector() const { return _detector; }
+        private:
+            Vec2 _key;
+            Vec2 _velocity;
+            Disc _detector;
+    };
+
+    /**
+     * Key distributions.
+     */
+    enum Distribution { UNIFORM, CLUSTERED, GAUSSIAN };
+
+    inline const char *name(Distribution distribution) {
+        return distribution == UNIFORM ? "uniform" : (distribution == CLUSTERED ? "clustered" : "gaussian");
+    }
+
+    /**
+     * Key generator, within [0;FIXTURE_AREA_SIZE] on both axes.
+     * 'CLUSTERED' draws around FIXTURE_CLUSTERS fixed centres, 'GAUSSIAN'
+     * around the centre of the area, so that a few leaves get most keys.
+     */
+    class Keys {
+        public:
+            Keys(Distribution distribution, unsigned long seed) : _distribution(distribution),
+                _mt(seed), _uniform(0.0f, FIXTURE_AREA_SIZE), _spread(0.0f, FIXTURE_CLUSTER_SPREAD),
+                _wide(FIXTURE_AREA_SIZE / 2.0f, FIXTURE_AREA_SIZE / 8.0f), _cluster(0, FIXTURE_CLUSTERS - 1) {
+                for(unsigned int i = 0; i < FIXTURE_CLUSTERS; ++i) {
+                    _centres.push_back(Vec2(_uniform(_mt), _uniform(_mt)));
+                }
+            }
+
+            Vec2 operator()() {
+                Vec2 result;
+                do {
+                    switch(_distribution) {
+                        case UNIFORM:
+                            result = Vec2(_uniform(_mt), _uniform(_mt));
+                            break;
+                        case CLUSTERED:
+                            result = _centres[_cluster(_mt)] + Vec2(_spread(_mt), _spread(_mt));
+                            break;
+                        case GAUSSIAN:
+                            result = Vec2(_wide(_mt), _wide(_mt));
+                            break;
+                    }
+                    // Redrawn rather than clamped: more equal keys than a leaf
+                    // holds would be split forever.
+                } while(!inside(result));
+                return result;
+            }
+
+            /**
+             * Bring a key back into the area by reflection on its borders.
+             */
+            static Vec2 reflect(const Vec2& key) {
+                return Vec2(reflect(key.x), reflect(key.y));
+            }
+
+            std::mt19937& generator() { return _mt; }
+        private:
+            static bool inside(const Vec2& key) {
+                return key.x >= 0.0f && key.x <= FIXTURE_AREA_SIZE &&
+                    key.y >= 0.0f && key.y <= FIXTURE_AREA_SIZE;
+            }
+            static float reflect(float value) {
+                value = value < 0.0f ? -value : value;
+                return value > FIXTURE_AREA_SIZE ? 2.0f * FIXTURE_AREA_SIZE - value : value;
+            }
+        private:
+            Distribution _distribution;
+            std::mt19937 _mt;
+            std::uniform_real_distribution<float> _uniform;
+            std::normal_distribution<float> _spread;
+            std::normal_distribution<float> _wide;
+            std::uniform_int_distribution<unsigned int> _cluster;
+            std::vector<Vec2> _centres;
+    };
+
+} // Namespace 'Bench'
+
+#endif
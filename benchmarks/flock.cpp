@@ -0,0 +1,159 @@
+/*
+ * Copyright 2016 Stoned Xander
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cmath>
+#include <string>
+#include <vector>
+#include "flock.hpp"
+#include "bench.hpp"
+#include "fixtures.hpp"
+
+#define SWARM_TICKS 10
+#define SWARM_ELAPSED 0.1f
+#define SWARM_RADIUS 16.0
+#define SWARM_SKIN 4.0
+#define SWARM_SPEED 20.0f
+
+namespace Bench {
+
+    typedef Headless::Logic::Flock::Swarm<Vec2, Box, Agent, Vec2, Disc> Swarm;
+
+    /**
+     * Tell if a perceived agent is within a force radius. Perception may go
+     * further: up to the largest force radius, or past it with cached lists.
+     */
+    inline bool within(const Agent *subject, const Agent *other, double radius) {
+        Vec2 offset = other->key() - subject->key();
+        return offset.x * offset.x + offset.y * offset.y <= radius * radius;
+    }
+
+    /**
+     * Steer towards the mean velocity of the neighbours.
+     */
+    class Alignment {
+        public:
+            Vec2 compute(double, Agent *subject, Agent **perceived, unsigned int count) {
+                Vec2 sum;
+                unsigned int near = 0;
+                for(unsigned int i = 0; i < count; ++i) {
+                    if(within(subject, perceived[i], radius())) {
+                        sum += perceived[i]->velocity();
+                        ++near;
+                    }
+                }
+                return near > 0 ? sum * (1.0 / near) - subject->velocity() : sum;
+            }
+            double weight() const { return 0.5; }
+            double radius() const { return SWARM_RADIUS; }
+    };
+
+    /**
+     * Push away from the neighbours, accumulating in place.
+     */
+    class Separation {
+        public:
+            void compute(double, Agent *subject, Agent **perceived, unsigned int count, Vec2& velocity) {
+                const Vec2& key = subject->key();
+                double limit = radius() * radius();
+                for(unsigned int i = 0; i < count; ++i) {
+                    Vec2 away = key - perceived[i]->key();
+                    double square = away.x * away.x + away.y * away.y;
+                    if(square > 0.0 && square <= limit) {
+                        velocity += away * (1.0 / square);
+                    }
+                }
+            }
+            double radius() const { return SWARM_RADIUS / 2.0; }
+    };
+
+    /**
+     * Integrate the velocity, capped, on a torus so that agents do not pile up
+     * against the borders.
+     */
+    class Integrator {
+        public:
+            Vec2 compute(const Vec2& steering, Agent *agent, float elapsed, unsigned int) {
+                Vec2 velocity = agent->velocity() + steering;
+                float speed = std::sqrt(velocity.x * velocity.x + velocity.y * velocity.y);
+                if(speed > SWARM_SPEED) {
+                    velocity = velocity * (SWARM_SPEED / speed);
+                }
+                agent->velocity(velocity);
+                Vec2 key = agent->key() + velocity * elapsed;
+                return Vec2(wrap(key.x), wrap(key.y));
+            }
+        private:
+            static float wrap(float value) {
+                float result = std::fmod(value, FIXTURE_AREA_SIZE);
+                return result < 0.0f ? result + FIXTURE_AREA_SIZE : result;
+            }
+    };
+
+    /**
+     * Benchmark swarm ticks.
+     * @param runner Runner.
+     * @param mode "serial", "parallel" or "cached".
+     * @param distribution Initial key distribution.
+     * @param count Number of agents.
+     */
+    void tick(Runner& runner, const std::string& mode, Distribution distribution, unsigned int count) {
+        std::string name = "flock/update/" + mode + "/" + Bench::name(distribution) + "/n" +
+            std::to_string(count);
+        if(!runner.enabled(name)) {
+            return;
+        }
+        Keys keys(distribution, count);
+        std::uniform_real_distribution<float> heading(-SWARM_SPEED, SWARM_SPEED);
+        std::vector<Agent> agents;
+        for(unsigned int i = 0; i < count; ++i) {
+            agents.push_back(Agent(keys(), SWARM_RADIUS));
+            agents.back().velocity(Vec2(heading(keys.generator()), heading(keys.generator())));
+        }
+        // Buffered, so that agents perceive the previous velocities in every mode.
+        Swarm swarm(Box(0.0f, 0.0f, FIXTURE_AREA_SIZE, FIXTURE_AREA_SIZE), count,
+                mode == "parallel", true);
+        for(Agent& agent : agents) {
+            swarm.add(&agent);
+        }
+        if(mode == "cached") {
+            swarm.cache(SWARM_SKIN, Euclidean());
+        }
+        Integrator integrator;
+        Alignment alignment;
+        Separation separation;
+        // A still wind, given as a mutable origin.
+        Vec2 wind;
+        runner.measure(name, SWARM_TICKS, [&]() {
+            for(unsigned int i = 0; i < SWARM_TICKS; ++i) {
+                swarm.update<Vec2>(SWARM_ELAPSED, wind, integrator, alignment, separation);
+            }
+        });
+    }
+
+    void flock(Runner& runner) {
+        std::vector<unsigned int> counts = runner.quick() ?
+            std::vector<unsigned int>{ 1024 } : std::vector<unsigned int>{ 1024, 8192 };
+        const char *modes[] = { "serial", "parallel", "cached" };
+        Distribution distributions[] = { UNIFORM, CLUSTERED };
+        for(Distribution distribution : distributions) {
+            for(unsigned int count : counts) {
+                for(const char *mode : modes) {
+                    tick(runner, mode, distribution, count);
+                }
+            }
+        }
+    }
+
+} // Namespace 'Bench'
@@ -0,0 +1,164 @@
+/*
+ * Copyright 2016 Stoned Xander
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <random>
+#include <string>
+#include <vector>
+#include "geneticalgorithm.hpp"
+#include "bench.hpp"
+
+#define GA_LENGTH 32
+#define GA_GENERATIONS 50
+#define GA_ELITE 0.1
+#define GA_SEED 42
+
+namespace Bench {
+
+    /**
+     * Fixed length string genome, as in the genetic algorithm example.
+     */
+    class Genome {
+        public:
+            Genome() {
+                for(unsigned int i = 0; i < GA_LENGTH; ++i) {
+                    data[i] = 'a';
+                }
+            }
+        public:
+            char data[GA_LENGTH];
+    };
+
+    /**
+     * Distance to a target string. The error never reaches the negative
+     * training threshold, so that every run lasts the same number of
+     * generations.
+     */
+    class Target {
+        public:
+            Target() : _mt(GA_SEED), _letter('a', 'z') {
+                for(unsigned int i = 0; i < GA_LENGTH; ++i) {
+                    _goal.data[i] = _letter(_mt);
+                }
+            }
+            void reserve(Genome**& buffer, unsigned int size) {
+                for(unsigned int i = 0; i < size; ++i) {
+                    buffer[i] = new Genome();
+                    for(unsigned int j = 0; j < GA_LENGTH; ++j) {
+                        buffer[i]->data[j] = _letter(_mt);
+                    }
+                }
+            }
+            void release(Genome** buffer, unsigned int size) {
+                for(unsigned int i = 0; i < size; ++i) {
+                    delete buffer[i];
+                }
+            }
+            double evaluate(const Genome *genome) {
+                double result = 0.0;
+                for(unsigned int i = 0; i < GA_LENGTH; ++i) {
+                    int delta = genome->data[i] - _goal.data[i];
+                    result += delta < 0 ? -delta : delta;
+                }
+                return result;
+            }
+            Genome *clone(const Genome *genome) { return new Genome(*genome); }
+        private:
+            Genome _goal;
+            std::mt19937 _mt;
+            std::uniform_int_distribution<char> _letter;
+    };
+
+    class Silent {
+        public:
+            void visit(Genome**, unsigned int) {}
+    };
+
+    /**
+     * Pick an elite member, proportionally to its reversed score.
+     */
+    inline unsigned int pick(double *score, double total, unsigned int count, std::mt19937& generator) {
+        double position = std::uniform_real_distribution<double>(0.0, total)(generator);
+        double cumulator = score[0];
+        unsigned int index = 0;
+        while(cumulator < position && index + 1 < count) {
+            cumulator += score[++index];
+        }
+        return index;
+    }
+
+    class Crossover {
+        public:
+            double threshold() { return 0.8; }
+            void mutate(Genome** elite, double* score, double total, unsigned int count,
+                    Genome* offspring, std::mt19937& generator) {
+                Genome *father = elite[pick(score, total, count, generator)];
+                Genome *mother = elite[pick(score, total, count, generator)];
+                unsigned int mask = generator();
+                for(unsigned int i = 0; i < GA_LENGTH; ++i) {
+                    offspring->data[i] = (mask >> i) & 1 ? father->data[i] : mother->data[i];
+                }
+            }
+    };
+
+    class Point {
+        public:
+            double threshold() { return 0.3; }
+            void mutate(Genome** elite, double* score, double total, unsigned int count,
+                    Genome* offspring, std::mt19937& generator) {
+                *offspring = *elite[pick(score, total, count, generator)];
+                offspring->data[generator() % GA_LENGTH] = 'a' + generator() % 26;
+            }
+    };
+
+    /**
+     * Run a training and release the stored results.
+     */
+    template <typename T> void run(T& engine, unsigned int limit, unsigned int size) {
+        Target env;
+        Silent visitor;
+        Crossover crossover;
+        Point point;
+        std::vector<Genome*> store(size);
+        int stored = std::get<2>(engine.train(&env, &visitor, limit, -1.0, GA_ELITE,
+                    store.data(), size, &point, &crossover));
+        for(int i = 0; i < stored; ++i) {
+            delete store[i];
+        }
+    }
+
+    void geneticAlgorithm(Runner& runner) {
+        std::vector<unsigned int> sizes = runner.quick() ?
+            std::vector<unsigned int>{ 256 } : std::vector<unsigned int>{ 256, 2048 };
+        for(unsigned int size : sizes) {
+            std::string suffix = "/p" + std::to_string(size);
+            runner.measure("ga/trivial/generation" + suffix, GA_GENERATIONS, [&]() {
+                Headless::Logic::GA::Trivial<Genome> engine(size, GA_SEED);
+                run(engine, GA_GENERATIONS, size);
+            });
+            runner.measure("ga/arena/generation" + suffix, GA_GENERATIONS, [&]() {
+                Headless::Logic::GA::Trivial<Genome> engine(size, GA_SEED, true);
+                run(engine, GA_GENERATIONS, size);
+            });
+            // As many evaluations as the generational engines perform.
+            unsigned int evaluations = size * GA_GENERATIONS;
+            runner.measure("ga/steady/evaluation" + suffix, evaluations, [&]() {
+                Headless::Logic::GA::SteadyState<Genome> engine(size,
+                        std::thread::hardware_concurrency(), 1, GA_SEED);
+                run(engine, evaluations, size);
+            });
+        }
+    }
+
+} // Namespace 'Bench'
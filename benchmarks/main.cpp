@@ -0,0 +1,69 @@
+/*
+ * Copyright 2016 Stoned Xander
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Benchmark suite of the library modules.
+ * Progress goes to the standard error, the JSON report to '--json'.
+ * With '--baseline', medians are compared with a previous report and the
+ * run fails if one of them regressed beyond '--tolerance'.
+ */
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include "bench.hpp"
+
+int main(int argc, char **argv) {
+    Bench::Options options;
+    if(!options.parse(argc, argv)) {
+        Bench::Options::usage(std::cerr);
+        return -1;
+    }
+    std::map<std::string, double> baseline;
+    if(!options.baseline.empty() && !Bench::load(options.baseline, baseline)) {
+        std::cerr << "Can't read baseline '" << options.baseline << "' !" << std::endl;
+        return -1;
+    }
+
+    Bench::Runner runner(options);
+    Bench::searchTree(runner);
+    Bench::flock(runner);
+    Bench::geneticAlgorithm(runner);
+    Bench::neuralNetwork(runner);
+    if(options.list) {
+        return 0;
+    }
+
+    if(options.json == "-") {
+        runner.json(std::cout);
+    } else if(!options.json.empty()) {
+        std::ofstream out(options.json.c_str());
+        if(!out) {
+            std::cerr << "Can't write report '" << options.json << "' !" << std::endl;
+            return -1;
+        }
+        runner.json(out);
+    }
+
+    int result = 0;
+    if(!options.baseline.empty()) {
+        unsigned int regressions = runner.compare(baseline, std::cout);
+        std::cout << regressions << " regression(s), tolerance "
+            << options.tolerance * 100.0 << "%" << std::endl;
+        result = regressions > 0 ? 1 : 0;
+    }
+    return result;
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright 2016 Stoned Xander
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "neuralnetwork.hpp"
+#include "bench.hpp"
+
+#define NN_INPUTS 8
+#define NN_OUTPUTS 4
+#define NN_STEPS 10000
+#define NN_BATCH 1000
+#define NN_BATCH_STEPS 20
+#define NN_SEED 42
+
+namespace Bench {
+
+    template <typename T> const char *precision();
+    template <> const char *precision<float>() { return "float"; }
+    template <> const char *precision<double>() { return "double"; }
+
+    /**
+     * Random weights and biases, small enough for the signals not to saturate.
+     * @param weights Weight rows.
+     * @param stride Weight row length.
+     * @param biases Biases.
+     * @param neurons Number of rows.
+     * @param signals Number of used columns.
+     */
+    template <typename T> void randomize(T *weights, unsigned int stride, T *biases,
+            unsigned int neurons, unsigned int signals, std::mt19937& mt) {
+        std::uniform_real_distribution<double> dist(-1.0, 1.0);
+        for(unsigned int i = 0; i < neurons; ++i) {
+            for(unsigned int j = 0; j < signals; ++j) {
+                weights[i * stride + j] = static_cast<T>(dist(mt) / signals);
+            }
+            biases[i] = static_cast<T>(dist(mt));
+        }
+    }
+
+    template <typename T> void networks(Runner& runner, unsigned int intermediate) {
+        using namespace Headless::Logic::NeuralNet;
+        std::string suffix = std::string("/") + precision<T>() + "/i" + std::to_string(intermediate);
+        std::mt19937 mt(NN_SEED);
+        std::vector<T> input(NN_BATCH * NN_INPUTS, T(0.5));
+        std::vector<T> output(NN_BATCH * NN_OUTPUTS);
+        Sigmoid<T> sigmoid;
+
+        TrivialMonoRecursive<T> trivial(NN_INPUTS, NN_OUTPUTS, intermediate);
+        randomize(trivial.weights(), trivial.stride(), trivial.biases(),
+                trivial.neurons(), trivial.signals(), mt);
+        runner.measure("nn/trivial/step" + suffix, NN_STEPS, [&]() {
+            for(unsigned int i = 0; i < NN_STEPS; ++i) {
+                trivial.compute(input.data(), output.data(), &sigmoid);
+            }
+            consume(output[0]);
+        });
+
+        MonoRecursive<Sigmoid<T>, T> mono(NN_INPUTS, NN_OUTPUTS, intermediate);
+        randomize(mono.weights(), mono.stride(), mono.biases(), mono.neurons(), mono.signals(), mt);
+        runner.measure("nn/mono/step" + suffix, NN_STEPS, [&]() {
+            for(unsigned int i = 0; i < NN_STEPS; ++i) {
+                mono.compute(input.data(), output.data());
+            }
+            consume(output[0]);
+        });
+
+        // One operation is one network step. The batch of private networks
+        // competes with as many networks stepped one by one, not with one
+        // network whose weights stay in cache.
+        std::vector<std::unique_ptr<TrivialMonoRecursive<T> > > singles;
+        for(unsigned int n = 0; n < NN_BATCH; ++n) {
+            singles.emplace_back(new TrivialMonoRecursive<T>(NN_INPUTS, NN_OUTPUTS, intermediate));
+            randomize(singles.back()->weights(), singles.back()->stride(), singles.back()->biases(),
+                    singles.back()->neurons(), singles.back()->signals(), mt);
+        }
+        runner.measure("nn/singles/step" + suffix, NN_BATCH * NN_BATCH_STEPS, [&]() {
+            for(unsigned int i = 0; i < NN_BATCH_STEPS; ++i) {
+                for(unsigned int n = 0; n < NN_BATCH; ++n) {
+                    singles[n]->compute(input.data() + n * NN_INPUTS,
+                            output.data() + n * NN_OUTPUTS, &sigmoid);
+                }
+            }
+            consume(output[0]);
+        });
+
+        bool modes[] = { true, false };
+        for(bool shared : modes) {
+            BatchedMonoRecursive<T> batch(NN_BATCH, NN_INPUTS, NN_OUTPUTS, intermediate, shared);
+            for(unsigned int n = 0; n < (shared ? 1 : NN_BATCH); ++n) {
+                TrivialMonoRecursive<T> source(NN_INPUTS, NN_OUTPUTS, intermediate);
+                randomize(source.weights(), source.stride(), source.biases(),
+                        source.neurons(), source.signals(), mt);
+                if(shared) {
+                    batch.load(source.weights(), source.stride(), source.biases());
+                } else {
+                    batch.load(n, source.weights(), source.stride(), source.biases());
+                }
+            }
+            runner.measure(std::string("nn/batched/") + (shared ? "shared" : "private") + suffix,
+                    NN_BATCH * NN_BATCH_STEPS, [&]() {
+                for(unsigned int i = 0; i < NN_BATCH_STEPS; ++i) {
+                    batch.compute(input.data(), output.data(), &sigmoid);
+                }
+                consume(output[0]);
+            });
+        }
+    }
+
+    void neuralNetwork(Runner& runner) {
+        unsigned int intermediates[] = { 3, 12, 48 };
+        for(unsigned int intermediate : intermediates) {
+            networks<float>(runner, intermediate);
+            networks<double>(runner, intermediate);
+        }
+    }
+
+} // Namespace 'Bench'
@@ -0,0 +1,187 @@
+/*
+ * Copyright 2016 Stoned Xander
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <climits>
+#include <memory>
+#include <string>
+#include <vector>
+#include "searchtree.hpp"
+#include "flattree.hpp"
+#include "mortontree.hpp"
+#include "grid.hpp"
+#include "bench.hpp"
+#include "fixtures.hpp"
+
+#define TREE_QUERY_COUNT 1024
+#define TREE_QUERY_RADIUS 16.0
+#define TREE_MOVE_STEP 2.0f
+// Single insertions and removals are linear in a Morton tree.
+#define TREE_MORTON_LIMIT 1024
+
+namespace Bench {
+
+    typedef Headless::Logic::SearchTree::Node<Vec2, Box, Agent> NodeTree;
+    typedef Headless::Logic::SearchTree::FlatTree<Vec2, Box, Agent> FlatTree;
+    typedef Headless::Logic::SearchTree::MortonTree<Vec2, Box, Agent> MortonTree;
+    typedef Headless::Logic::SearchTree::Grid<Vec2, Box, Agent> GridTree;
+
+    /**
+     * Tree layout description.
+     * @param <T> Tree type.
+     */
+    template <typename T> class Layout;
+
+    template <> class Layout<NodeTree> {
+        public:
+            static const char *name() { return "node"; }
+            static NodeTree *create(const Box *region, unsigned int cardinality) {
+                return new NodeTree(region, cardinality);
+            }
+            static unsigned int limit() { return UINT_MAX; }
+    };
+
+    template <> class Layout<FlatTree> {
+        public:
+            static const char *name() { return "flat"; }
+            static FlatTree *create(const Box *region, unsigned int cardinality) {
+                return new FlatTree(region, cardinality);
+            }
+            static unsigned int limit() { return UINT_MAX; }
+    };
+
+    template <> class Layout<MortonTree> {
+        public:
+            static const char *name() { return "morton"; }
+            static MortonTree *create(const Box *region, unsigned int cardinality) {
+                return new MortonTree(region, cardinality);
+            }
+            static unsigned int limit() { return TREE_MORTON_LIMIT; }
+    };
+
+    template <> class Layout<GridTree> {
+        public:
+            static const char *name() { return "grid"; }
+            // The grid has a fixed depth instead of a cardinality, reported as 0.
+            static GridTree *create(const Box *region, unsigned int) {
+                return new GridTree(region);
+            }
+            static unsigned int limit() { return UINT_MAX; }
+    };
+
+    /**
+     * Benchmark the operations of a tree layout on one pool.
+     * @param <T> Tree type.
+     * @param runner Runner.
+     * @param region Tree region.
+     * @param cardinality Leaf cardinality.
+     * @param distribution Key distribution.
+     * @param count Pool size.
+     */
+    template <typename T> void stress(Runner& runner, const Box *region, unsigned int cardinality,
+            Distribution distribution, unsigned int count) {
+        std::string suffix = std::string("/") + Bench::name(distribution) + "/c" +
+            std::to_string(cardinality) + "/n" + std::to_string(count);
+        std::string prefix = std::string("searchtree/") + Layout<T>::name() + "/";
+
+        Keys keys(distribution, count);
+        std::vector<Agent> agents;
+        for(unsigned int i = 0; i < count; ++i) {
+            agents.push_back(Agent(keys(), TREE_QUERY_RADIUS));
+        }
+        std::vector<Agent*> pool;
+        for(Agent& agent : agents) {
+            pool.push_back(&agent);
+        }
+        // Moves go back and forth, so that the distribution does not drift.
+        std::uniform_real_distribution<float> step(-TREE_MOVE_STEP, TREE_MOVE_STEP);
+        std::vector<Vec2> steps;
+        for(unsigned int i = 0; i < count; ++i) {
+            steps.push_back(Vec2(step(keys.generator()), step(keys.generator())));
+        }
+        std::vector<Vec2> targets(count);
+        float direction = 1.0f;
+        auto target = [&]() {
+            for(unsigned int i = 0; i < count; ++i) {
+                targets[i] = Keys::reflect(pool[i]->key() + steps[i] * direction);
+            }
+            direction = -direction;
+        };
+        std::vector<Disc> queries;
+        for(unsigned int i = 0; i < TREE_QUERY_COUNT; ++i) {
+            queries.push_back(Disc(keys(), TREE_QUERY_RADIUS));
+        }
+
+        std::unique_ptr<T> tree;
+        auto empty = [&]() { tree.reset(Layout<T>::create(region, cardinality)); };
+        auto full = [&]() {
+            empty();
+            for(Agent *agent : pool) {
+                tree->add(agent);
+            }
+        };
+        if(count <= Layout<T>::limit()) {
+            runner.measure(prefix + "add" + suffix, count, [&]() {
+                for(Agent *agent : pool) {
+                    tree->add(agent);
+                }
+            }, empty);
+            runner.measure(prefix + "remove" + suffix, count, [&]() {
+                for(Agent *agent : pool) {
+                    tree->remove(agent);
+                }
+            }, full);
+            full();
+            runner.measure(prefix + "move" + suffix, count, [&]() {
+                for(unsigned int i = 0; i < count; ++i) {
+                    tree->move(pool[i], targets[i]);
+                }
+            }, target);
+        }
+        full();
+        runner.measure(prefix + "moveall" + suffix, count, [&]() {
+            tree->moveAll(pool.data(), targets.data(), count);
+        }, target);
+        runner.measure(prefix + "fill" + suffix, count, [&]() {
+            tree->build(pool.data(), count);
+        });
+        std::vector<Agent*> buffer(count);
+        runner.measure(prefix + "retrieve" + suffix, TREE_QUERY_COUNT, [&]() {
+            unsigned int found = 0;
+            for(const Disc& query : queries) {
+                found += tree->retrieve(query, buffer.data(), count);
+            }
+            consume(found);
+        });
+    }
+
+    void searchTree(Runner& runner) {
+        Box region(0.0f, 0.0f, FIXTURE_AREA_SIZE, FIXTURE_AREA_SIZE);
+        std::vector<unsigned int> counts = runner.quick() ?
+            std::vector<unsigned int>{ 1024 } : std::vector<unsigned int>{ 1024, 16384 };
+        unsigned int cardinalities[] = { 4, 16, 64 };
+        Distribution distributions[] = { UNIFORM, CLUSTERED, GAUSSIAN };
+        for(Distribution distribution : distributions) {
+            for(unsigned int count : counts) {
+                for(unsigned int cardinality : cardinalities) {
+                    stress<NodeTree>(runner, &region, cardinality, distribution, count);
+                    stress<FlatTree>(runner, &region, cardinality, distribution, count);
+                }
+                stress<MortonTree>(runner, &region, DEFAULT_CARD, distribution, count);
+                stress<GridTree>(runner, &region, 0, distribution, count);
+            }
+        }
+    }
+
+} // Namespace 'Bench'
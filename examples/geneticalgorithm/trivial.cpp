@@ -3,6 +3,7 @@
 #include <string>
 #include <random>
 #include <tuple>
+#include <cstdlib>
 
 #define POOL_SIZE 256
 #define MAX_GENERATION 1000000
@@ -10,7 +11,11 @@
 
 #define DATA_LENGTH 32
 
-std::random_device *s_rd;
+#define MIGRATION_INTERVAL 10
+#define MIGRANTS 2
+#define MAX_EVALUATIONS 10000000
+#define CACHE_SIZE 4096
+
 std::mt19937 *s_mt;
 std::uniform_int_distribution<char> s_upperDist('A', 'Z');
 std::uniform_int_distribution<char> s_lowerDist('a', 'z');
@@ -107,26 +112,33 @@ Candidate *Environment::clone(const Candidate *candidate) {
     return new Candidate(*candidate);
 }
 
+// Roulette ------------------------------------------------------------------
+// Pick an elite member proportionally to its reversed score, within [0, size).
+unsigned int pick(double* score, double total, unsigned int size, std::mt19937 &generator) {
+    double position = s_range(generator) * total;
+    unsigned int index = 0;
+    double cumulator = score[0];
+    while(cumulator < position && index + 1 < size) {
+        cumulator += score[++index];
+    }
+    return index;
+}
+
 // Mate Mutator --------------------------------------------------------------
 class MateMutator {
     public:
         double threshold();
-        void mutate(Candidate**, double*, double, unsigned int, Candidate*);
+        void mutate(Candidate**, double*, double, unsigned int, Candidate*, std::mt19937&);
 };
 
 double MateMutator::threshold() { return 0.8; }
 
-void MateMutator::mutate(Candidate** parents, double* score, double total, unsigned int size, Candidate* offspring) {
+void MateMutator::mutate(Candidate** parents, double* score, double total, unsigned int size, Candidate* offspring,
+        std::mt19937 &generator) {
     // Choose two parents.
-    double position = s_range(*s_mt) * total;
-    unsigned int index;
-    double cumulator = 0;
-    for(index = 0; cumulator < position; cumulator += score[index++]);
-    unsigned int mate;
-    position = s_range(*s_mt) * total;
-    cumulator = 0;
-    for(mate = 0; cumulator < position; cumulator += score[mate++]);
-    if(index == mate) { // Ugly, ugly, ugly ...
+    unsigned int index = pick(score, total, size, generator);
+    unsigned int mate = pick(score, total, size, generator);
+    if(index == mate && size > 1) { // Ugly, ugly, ugly ...
         if(mate == 0) {
             mate = 1;
         } else if(mate == size - 1) {
@@ -140,7 +152,7 @@ void MateMutator::mutate(Candidate** parents, double* score, double total, unsig
     char *junior = offspring->data();
 
     for(unsigned int i = 0; i < DATA_LENGTH - 1; ++i) {
-        junior[i] = (s_cass(*s_mt) == 0)?father[i]:mother[i];
+        junior[i] = (s_cass(generator) == 0)?father[i]:mother[i];
     }
 }
 
@@ -148,27 +160,25 @@ void MateMutator::mutate(Candidate** parents, double* score, double total, unsig
 class ClassicMutator {
     public:
         double threshold();
-        void mutate(Candidate**, double*, double, unsigned int, Candidate*);
+        void mutate(Candidate**, double*, double, unsigned int, Candidate*, std::mt19937&);
 };
 
 
 double ClassicMutator::threshold() { return 0.3; }
 
-void ClassicMutator::mutate(Candidate** parents, double* score, double total, unsigned int size, Candidate* offspring) {
+void ClassicMutator::mutate(Candidate** parents, double* score, double total, unsigned int size, Candidate* offspring,
+        std::mt19937 &generator) {
     // Let's take one of the offspring and mutate its genes !
-    double position = s_range(*s_mt) * total;
-    unsigned int index;
-    double cumulator = 0;
-    for(index = 0; cumulator < position; cumulator += score[index++]);
+    unsigned int index = pick(score, total, size, generator);
     Candidate *parent = parents[index];
     *offspring = *parent; // Copy ...
     // ... and mutate one of the character.
-    index = static_cast<unsigned int>(s_range(*s_mt) * (DATA_LENGTH - 1));
+    index = static_cast<unsigned int>(s_range(generator) * (DATA_LENGTH - 1));
     char *data = offspring->data();
-    if(s_cass(*s_mt) == 1) { // upper case
-        data[index] = s_upperDist(*s_mt);
+    if(s_cass(generator) == 1) { // upper case
+        data[index] = s_upperDist(generator);
     } else {
-        data[index] = s_lowerDist(*s_mt);
+        data[index] = s_lowerDist(generator);
     }
 }
 
@@ -182,14 +192,76 @@ class Visitor {
                     << pool[i]->data() << std::endl;
             }
         }
+        void cache(unsigned long hits, unsigned long misses) {
+            std::cout << "Cache hits : " << hits << " / " << (hits + misses) << std::endl;
+        }
 };
 
-// Example Entry Point -------------------------------------------------------
-int main(void) {
-    s_rd = new std::random_device();
-    s_mt = new std::mt19937((*s_rd)());
+// Candidate Hash ------------------------------------------------------------
+// The genome itself is an exact key.
+class CandidateHash {
+    public:
+        std::string operator()(const Candidate *candidate) const {
+            return std::string(const_cast<Candidate*>(candidate)->data(), DATA_LENGTH);
+        }
+};
 
-    Headless::Logic::GA::Trivial<Candidate> engine(POOL_SIZE);
+typedef Headless::Logic::GA::Cached<Environment, Candidate, CandidateHash> CachedEnvironment;
+
+// Training ------------------------------------------------------------------
+template <typename E, typename V> std::tuple<int, double, int> train(E *env, V *visitor,
+        bool arena, unsigned int islands, unsigned int workers, unsigned long seed,
+        Candidate **store, ClassicMutator *mutate, MateMutator *mate) {
+    if(islands > 0) {
+        Headless::Logic::GA::Islands<Candidate> archipelago(islands, POOL_SIZE,
+                MIGRATION_INTERVAL, MIGRANTS, seed);
+        std::tuple<int, double, int> result = archipelago.train(env, visitor,
+                MAX_GENERATION, MIN_ERROR, 0.1,
+                store, POOL_SIZE,
+                mutate, mate);
+        std::cout << "Migrants : " << archipelago.migrations() << std::endl;
+        return result;
+    } else if(workers > 0) {
+        // Reports evaluations rather than generations.
+        Headless::Logic::GA::SteadyState<Candidate> steady(POOL_SIZE, workers, 1, seed);
+        return steady.train(env, visitor,
+                MAX_EVALUATIONS, MIN_ERROR, 0.1,
+                store, POOL_SIZE,
+                mutate, mate);
+    }
+    Headless::Logic::GA::Trivial<Candidate> engine(POOL_SIZE, seed, arena);
+    return engine.train(env, visitor,
+            MAX_GENERATION, MIN_ERROR, 0.1,
+            store, POOL_SIZE,
+            mutate, mate);
+}
+
+// Example Entry Point -------------------------------------------------------
+// Usage: trivial [--cache] [--arena | --islands count | --steady workers] [seed].
+// Trivial runs with the same seed and thread count are identical.
+int main(int argc, char **argv) {
+    bool arena = false;
+    unsigned int islands = 0;
+    unsigned int workers = 0;
+    bool cache = false;
+    int next = 1;
+    if(argc > next && std::string(argv[next]) == "--cache") {
+        cache = true;
+        ++next;
+    }
+    if(argc > next && std::string(argv[next]) == "--arena") {
+        arena = true;
+        ++next;
+    } else if(argc > next + 1 && std::string(argv[next]) == "--islands") {
+        islands = std::strtoul(argv[next + 1], nullptr, 10);
+        next += 2;
+    } else if(argc > next + 1 && std::string(argv[next]) == "--steady") {
+        workers = std::strtoul(argv[next + 1], nullptr, 10);
+        next += 2;
+    }
+    unsigned long seed = (argc > next) ? std::strtoul(argv[next], nullptr, 10) : std::random_device()();
+    std::cout << "Seed : " << seed << std::endl;
+    s_mt = new std::mt19937(seed);
 
     Environment env;
     MateMutator mate;
@@ -239,10 +311,15 @@ int main(void) {
     int result;
     double minimum;
     int number;
-    std::tie(number, minimum, result) = engine.train(&env, &visitor,
-            MAX_GENERATION, MIN_ERROR, 0.1,
-            store, POOL_SIZE,
-            &mutate, &mate);
+    if(cache) {
+        CachedEnvironment cached(&env, CACHE_SIZE);
+        CachedEnvironment::Visitor<Visitor> reporting(&cached, &visitor);
+        std::tie(number, minimum, result) = train(&cached, &reporting,
+                arena, islands, workers, seed, store, &mutate, &mate);
+    } else {
+        std::tie(number, minimum, result) = train(&env, &visitor,
+                arena, islands, workers, seed, store, &mutate, &mate);
+    }
 
     std::cout << "Number of generations : " << number << std::endl;
     std::cout << "Minimal score : " << minimum << std::endl;
@@ -252,13 +329,13 @@ int main(void) {
         std::cout << "#" << i << " : " << store[i]->data() << std::endl;
     }
 
-    for(unsigned int i = 0; i < POOL_SIZE; ++i) {
+    // Only 'result' candidates have been stored.
+    for(int i = 0; i < result; ++i) {
         delete store[i];
     }
     delete[] store;
 
     delete s_mt;
-    delete s_rd;
 
     return 0;
 }
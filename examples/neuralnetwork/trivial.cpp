@@ -0,0 +1,381 @@
+#include <neuralnetwork.hpp>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#define INPUT_COUNT 16
+#define OUTPUT_COUNT 4
+#define STEP_COUNT 1000
+#define TOLERANCE 1e-4
+#define BATCH_SIZE 1000
+#define BATCH_INTERMEDIATE 12
+#define BATCH_STEP_COUNT 100
+// The approximated activations are 1e-4 accurate.
+#define APPROXIMATION_TOLERANCE 1e-4
+#define APPROXIMATION_RANGE 6.0
+#define APPROXIMATION_SAMPLES 120001
+
+// Sigmoid activation --------------------------------------------------------
+template <typename T> class ExactSigmoid {
+    public:
+        T compute(T inValue, T bias) {
+            return T(1) / (T(1) + std::exp(-(inValue + bias)));
+        }
+};
+
+template <typename T> class ExactTanh {
+    public:
+        T compute(T inValue, T bias) {
+            return std::tanh(inValue + bias);
+        }
+};
+
+template <typename T> class ExactReLU {
+    public:
+        T compute(T inValue, T bias) {
+            return std::max(T(0), inValue + bias);
+        }
+};
+
+/**
+ * Compare 'fastTanh' with 'std::tanh' over
+ * [-APPROXIMATION_RANGE;APPROXIMATION_RANGE], past the clamp.
+ * @return Largest difference.
+ */
+template <typename T> double checkFastTanh() {
+    double error = 0;
+    for(unsigned int i = 0; i < APPROXIMATION_SAMPLES; ++i) {
+        T x = static_cast<T>(-APPROXIMATION_RANGE + 2.0 * APPROXIMATION_RANGE * i / (APPROXIMATION_SAMPLES - 1));
+        error = std::max(error, std::fabs(static_cast<double>(Headless::Logic::NeuralNet::fastTanh(x))
+                    - std::tanh(static_cast<double>(x))));
+    }
+    return error;
+}
+
+/**
+ * Compare both entry points of an activation, 'compute' with a bias and
+ * 'apply' on a whole layer, with the exact function over
+ * [-APPROXIMATION_RANGE;APPROXIMATION_RANGE].
+ * @param <A> Activation.
+ * @param <E> Exact activation.
+ * @return Largest difference.
+ */
+template <typename T, template <typename> class A, template <typename> class E> double checkActivation() {
+    const A<T> activation = A<T>();
+    E<double> exact;
+    std::vector<T> values(APPROXIMATION_SAMPLES);
+    std::vector<double> expected(APPROXIMATION_SAMPLES);
+    double error = 0;
+    for(unsigned int i = 0; i < APPROXIMATION_SAMPLES; ++i) {
+        values[i] = static_cast<T>(-APPROXIMATION_RANGE + 2.0 * APPROXIMATION_RANGE * i / (APPROXIMATION_SAMPLES - 1));
+        expected[i] = exact.compute(static_cast<double>(values[i]), 0.0);
+        // Biased, so that 'compute' does not only see the input unchanged.
+        T shifted = values[i] - T(0.5);
+        error = std::max(error, std::fabs(static_cast<double>(activation.compute(shifted, T(0.5)))
+                    - exact.compute(static_cast<double>(shifted), 0.5)));
+    }
+    activation.apply(values.data(), APPROXIMATION_SAMPLES);
+    for(unsigned int i = 0; i < APPROXIMATION_SAMPLES; ++i) {
+        error = std::max(error, std::fabs(static_cast<double>(values[i]) - expected[i]));
+    }
+    return error;
+}
+
+/**
+ * Step a network with random weights and compare it against a plain
+ * matrix-vector step.
+ * @param intermediate Number of intermediate neurons.
+ * @return Largest difference with the reference.
+ */
+template <typename T> double check(unsigned int intermediate, std::mt19937 &mt) {
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    Headless::Logic::NeuralNet::TrivialMonoRecursive<T> net(INPUT_COUNT, OUTPUT_COUNT, intermediate);
+    const unsigned int signals = net.signals();
+    const unsigned int neurons = net.neurons();
+    std::vector<double> weights(signals * neurons);
+    std::vector<double> biases(neurons);
+    for(unsigned int i = 0; i < neurons; ++i) {
+        for(unsigned int j = 0; j < signals; ++j) {
+            weights[i * signals + j] = dist(mt) / signals;
+            net.weights()[i * net.stride() + j] = static_cast<T>(weights[i * signals + j]);
+        }
+        biases[i] = dist(mt);
+        net.biases()[i] = static_cast<T>(biases[i]);
+    }
+    std::vector<double> state(neurons, 0.0);
+    std::vector<double> in(signals);
+    T input[INPUT_COUNT];
+    T output[OUTPUT_COUNT];
+    ExactSigmoid<T> sigmoid;
+    double error = 0;
+    for(unsigned int step = 0; step < 10; ++step) {
+        for(unsigned int j = 0; j < INPUT_COUNT; ++j) {
+            in[j] = (dist(mt) + 1.0) / 2.0;
+            input[j] = static_cast<T>(in[j]);
+        }
+        for(unsigned int j = 0; j < neurons; ++j) {
+            in[INPUT_COUNT + j] = state[j];
+        }
+        for(unsigned int i = 0; i < neurons; ++i) {
+            double sum = 0;
+            for(unsigned int j = 0; j < signals; ++j) {
+                sum += weights[i * signals + j] * in[j];
+            }
+            state[i] = 1.0 / (1.0 + std::exp(-(sum + biases[i])));
+        }
+        net.compute(input, output, &sigmoid);
+        for(unsigned int i = 0; i < OUTPUT_COUNT; ++i) {
+            error = std::max(error, std::fabs(output[i] - state[i]));
+        }
+    }
+    return error;
+}
+
+/**
+ * @return Steps per second of a network.
+ */
+template <typename T> double measure(unsigned int intermediate) {
+    Headless::Logic::NeuralNet::TrivialMonoRecursive<T> net(INPUT_COUNT, OUTPUT_COUNT, intermediate);
+    for(unsigned int i = 0; i < net.neurons(); ++i) {
+        for(unsigned int j = 0; j < net.signals(); ++j) {
+            net.weights()[i * net.stride() + j] = T(1) / net.signals();
+        }
+    }
+    T input[INPUT_COUNT];
+    T output[OUTPUT_COUNT];
+    for(unsigned int j = 0; j < INPUT_COUNT; ++j) {
+        input[j] = T(0.5);
+    }
+    ExactSigmoid<T> sigmoid;
+    auto start = std::chrono::high_resolution_clock::now();
+    for(unsigned int step = 0; step < STEP_COUNT; ++step) {
+        net.compute(input, output, &sigmoid);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return STEP_COUNT / std::chrono::duration<double>(end - start).count();
+}
+
+/**
+ * Step a batch of networks and compare it against the same networks
+ * stepped one by one.
+ * @param <A> Activation, either per neuron or Vectorized.
+ * @param shared Shared weights flag.
+ * @return Largest difference with the networks stepped one by one.
+ */
+template <typename T, template <typename> class A> double checkBatch(bool shared, std::mt19937 &mt) {
+    typedef Headless::Logic::NeuralNet::TrivialMonoRecursive<T> Net;
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    Headless::Logic::NeuralNet::BatchedMonoRecursive<T> batch(BATCH_SIZE, INPUT_COUNT, OUTPUT_COUNT,
+            BATCH_INTERMEDIATE, shared);
+    std::vector<Net*> nets;
+    for(unsigned int b = 0; b < BATCH_SIZE; ++b) {
+        Net *net = new Net(INPUT_COUNT, OUTPUT_COUNT, BATCH_INTERMEDIATE);
+        if(shared && b > 0) {
+            std::copy(nets[0]->weights(), nets[0]->weights() + net->neurons() * net->stride(), net->weights());
+            std::copy(nets[0]->biases(), nets[0]->biases() + net->neurons(), net->biases());
+        } else {
+            for(unsigned int i = 0; i < net->neurons(); ++i) {
+                for(unsigned int j = 0; j < net->signals(); ++j) {
+                    net->weights()[i * net->stride() + j] = static_cast<T>(dist(mt) / net->signals());
+                }
+                net->biases()[i] = static_cast<T>(dist(mt));
+            }
+        }
+        if(!shared) {
+            batch.load(b, net->weights(), net->stride(), net->biases());
+        }
+        nets.push_back(net);
+    }
+    if(shared) {
+        batch.load(nets[0]->weights(), nets[0]->stride(), nets[0]->biases());
+    }
+    std::vector<T> input(BATCH_SIZE * INPUT_COUNT);
+    std::vector<T> output(BATCH_SIZE * OUTPUT_COUNT);
+    T single[OUTPUT_COUNT];
+    A<T> function;
+    double error = 0;
+    for(unsigned int step = 0; step < 10; ++step) {
+        for(unsigned int j = 0; j < input.size(); ++j) {
+            input[j] = static_cast<T>((dist(mt) + 1.0) / 2.0);
+        }
+        batch.compute(input.data(), output.data(), &function);
+        for(unsigned int b = 0; b < BATCH_SIZE; ++b) {
+            nets[b]->compute(input.data() + b * INPUT_COUNT, single, &function);
+            for(unsigned int i = 0; i < OUTPUT_COUNT; ++i) {
+                error = std::max(error, static_cast<double>(std::fabs(single[i] - output[b * OUTPUT_COUNT + i])));
+            }
+        }
+    }
+    for(Net *net : nets) {
+        delete net;
+    }
+    return error;
+}
+
+/**
+ * @return Network steps per second, stepping the networks one by one.
+ */
+template <typename T> double measureSingles() {
+    typedef Headless::Logic::NeuralNet::TrivialMonoRecursive<T> Net;
+    std::vector<Net*> nets;
+    for(unsigned int b = 0; b < BATCH_SIZE; ++b) {
+        nets.push_back(new Net(INPUT_COUNT, OUTPUT_COUNT, BATCH_INTERMEDIATE));
+    }
+    std::vector<T> input(BATCH_SIZE * INPUT_COUNT, T(0.5));
+    std::vector<T> output(BATCH_SIZE * OUTPUT_COUNT);
+    ExactSigmoid<T> sigmoid;
+    auto start = std::chrono::high_resolution_clock::now();
+    for(unsigned int step = 0; step < BATCH_STEP_COUNT; ++step) {
+        for(unsigned int b = 0; b < BATCH_SIZE; ++b) {
+            nets[b]->compute(input.data() + b * INPUT_COUNT, output.data() + b * OUTPUT_COUNT, &sigmoid);
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    for(Net *net : nets) {
+        delete net;
+    }
+    return BATCH_STEP_COUNT * BATCH_SIZE / std::chrono::duration<double>(end - start).count();
+}
+
+/**
+ * @return Network steps per second, stepping the networks as a batch.
+ */
+template <typename T> double measureBatch(bool shared) {
+    Headless::Logic::NeuralNet::BatchedMonoRecursive<T> batch(BATCH_SIZE, INPUT_COUNT, OUTPUT_COUNT,
+            BATCH_INTERMEDIATE, shared);
+    std::vector<T> input(BATCH_SIZE * INPUT_COUNT, T(0.5));
+    std::vector<T> output(BATCH_SIZE * OUTPUT_COUNT);
+    ExactSigmoid<T> sigmoid;
+    auto start = std::chrono::high_resolution_clock::now();
+    for(unsigned int step = 0; step < BATCH_STEP_COUNT; ++step) {
+        batch.compute(input.data(), output.data(), &sigmoid);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return BATCH_STEP_COUNT * BATCH_SIZE / std::chrono::duration<double>(end - start).count();
+}
+
+/**
+ * Step a MonoRecursive, with its approximated activation, against the same
+ * network with the exact one.
+ * @param <A> Activation.
+ * @param <E> Exact activation.
+ * @return Largest difference.
+ */
+template <typename T, template <typename> class A, template <typename> class E>
+double checkMono(unsigned int intermediate, std::mt19937 &mt) {
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    Headless::Logic::NeuralNet::TrivialMonoRecursive<T> exact(INPUT_COUNT, OUTPUT_COUNT, intermediate);
+    Headless::Logic::NeuralNet::MonoRecursive<A<T>, T> mono(INPUT_COUNT, OUTPUT_COUNT, intermediate);
+    for(unsigned int i = 0; i < exact.neurons(); ++i) {
+        for(unsigned int j = 0; j < exact.signals(); ++j) {
+            T weight = static_cast<T>(dist(mt) / exact.signals());
+            exact.weights()[i * exact.stride() + j] = weight;
+            mono.weights()[i * mono.stride() + j] = weight;
+        }
+        exact.biases()[i] = mono.biases()[i] = static_cast<T>(dist(mt));
+    }
+    T input[INPUT_COUNT];
+    T expected[OUTPUT_COUNT];
+    T output[OUTPUT_COUNT];
+    E<T> function;
+    double error = 0;
+    for(unsigned int step = 0; step < 10; ++step) {
+        for(unsigned int j = 0; j < INPUT_COUNT; ++j) {
+            input[j] = static_cast<T>((dist(mt) + 1.0) / 2.0);
+        }
+        exact.compute(input, expected, &function);
+        mono.compute(input, output);
+        for(unsigned int i = 0; i < OUTPUT_COUNT; ++i) {
+            error = std::max(error, static_cast<double>(std::fabs(expected[i] - output[i])));
+        }
+    }
+    return error;
+}
+
+/**
+ * @return Steps per second of a MonoRecursive.
+ */
+template <typename T> double measureMono(unsigned int intermediate) {
+    Headless::Logic::NeuralNet::MonoRecursive<Headless::Logic::NeuralNet::Sigmoid<T>, T> net(
+            INPUT_COUNT, OUTPUT_COUNT, intermediate);
+    for(unsigned int i = 0; i < net.neurons(); ++i) {
+        for(unsigned int j = 0; j < net.signals(); ++j) {
+            net.weights()[i * net.stride() + j] = T(1) / net.signals();
+        }
+    }
+    T input[INPUT_COUNT];
+    T output[OUTPUT_COUNT];
+    for(unsigned int j = 0; j < INPUT_COUNT; ++j) {
+        input[j] = T(0.5);
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    for(unsigned int step = 0; step < STEP_COUNT; ++step) {
+        net.compute(input, output);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return STEP_COUNT / std::chrono::duration<double>(end - start).count();
+}
+
+// Example Entry Point -------------------------------------------------------
+int main(void) {
+    using Headless::Logic::NeuralNet::Sigmoid;
+    using Headless::Logic::NeuralNet::Tanh;
+    using Headless::Logic::NeuralNet::ReLU;
+    std::mt19937 mt(0);
+    bool success = true;
+    std::cout << "Activation, Float error, Double error" << std::endl;
+    double errors[4][2] = {
+        { checkFastTanh<float>(), checkFastTanh<double>() },
+        { checkActivation<float, Sigmoid, ExactSigmoid>(), checkActivation<double, Sigmoid, ExactSigmoid>() },
+        { checkActivation<float, Tanh, ExactTanh>(), checkActivation<double, Tanh, ExactTanh>() },
+        { checkActivation<float, ReLU, ExactReLU>(), checkActivation<double, ReLU, ExactReLU>() }
+    };
+    const char *activations[4] = { "fastTanh", "Sigmoid", "Tanh", "ReLU" };
+    for(unsigned int i = 0; i < 4; ++i) {
+        success = success && errors[i][0] < APPROXIMATION_TOLERANCE && errors[i][1] < APPROXIMATION_TOLERANCE;
+        std::cout << activations[i] << ", " << errors[i][0] << ", " << errors[i][1] << std::endl;
+    }
+
+    std::cout << "Intermediate, Float error, Double error, Float (steps/s), Double (steps/s)" << std::endl;
+    for(unsigned int intermediate = 3; intermediate <= 2048; intermediate *= 4) {
+        double floatError = check<float>(intermediate, mt);
+        double doubleError = check<double>(intermediate, mt);
+        success = success && floatError < TOLERANCE && doubleError < TOLERANCE;
+        std::cout << intermediate << ", " << floatError << ", " << doubleError << ", "
+            << measure<float>(intermediate) << ", " << measure<double>(intermediate) << std::endl;
+    }
+
+    std::cout << "MonoRecursive, Intermediate, Float error, Double error, "
+        << "Float (steps/s), Double (steps/s)" << std::endl;
+    for(unsigned int intermediate = 3; intermediate <= 2048; intermediate *= 4) {
+        double floatError = checkMono<float, Sigmoid, ExactSigmoid>(intermediate, mt);
+        double doubleError = checkMono<double, Sigmoid, ExactSigmoid>(intermediate, mt);
+        success = success && floatError < APPROXIMATION_TOLERANCE && doubleError < APPROXIMATION_TOLERANCE;
+        std::cout << intermediate << ", " << floatError << ", " << doubleError << ", "
+            << measureMono<float>(intermediate) << ", " << measureMono<double>(intermediate) << std::endl;
+    }
+
+    std::cout << "Batch of " << BATCH_SIZE << ", Float error, Double error, "
+        << "Float (network steps/s), Double (network steps/s)" << std::endl;
+    for(unsigned int mode = 0; mode < 3; ++mode) {
+        bool shared = mode == 1;
+        double floatError = mode == 0 ? 0 : checkBatch<float, ExactSigmoid>(shared, mt);
+        double doubleError = mode == 0 ? 0 : checkBatch<double, ExactSigmoid>(shared, mt);
+        // Same again through the Vectorized path, 'apply' on whole layers.
+        if(mode != 0) {
+            floatError = std::max(floatError, std::max(checkBatch<float, Sigmoid>(shared, mt),
+                        checkBatch<float, Tanh>(shared, mt)));
+            doubleError = std::max(doubleError, std::max(checkBatch<double, Sigmoid>(shared, mt),
+                        checkBatch<double, Tanh>(shared, mt)));
+        }
+        success = success && floatError < TOLERANCE && doubleError < TOLERANCE;
+        std::cout << (mode == 0 ? "One by one" : (shared ? "Shared weights" : "Own weights")) << ", "
+            << floatError << ", " << doubleError << ", "
+            << (mode == 0 ? measureSingles<float>() : measureBatch<float>(shared)) << ", "
+            << (mode == 0 ? measureSingles<double>() : measureBatch<double>(shared)) << std::endl;
+    }
+    std::cout << (success ? "Success" : "Failure") << std::endl;
+    return success ? 0 : 1;
+}
@@ -1,8 +1,15 @@
+#include <algorithm>
+#include <cmath>
 #include "common.hpp"
 
 
 const Region *Region::divide() const {
     Region *ary = new Region[4];
+    divide(ary);
+    return ary;
+}
+
+void Region::divide(Region *ary) const {
     double width = _boundary.p / 2.0;
     double height = _boundary.q / 2.0;
     double upX = _boundary.x;
@@ -11,7 +18,42 @@ const Region *Region::divide() const {
     ary[1]._boundary = glm::vec4(upX + width, upY, width, height);
     ary[2]._boundary = glm::vec4(upX + width, upY + height, width, height);
     ary[3]._boundary = glm::vec4(upX, upY + height, width, height);
-    return ary;
+}
+
+unsigned int Region::index(const glm::vec2 &key) const {
+    // Same edges as 'divide', a key on an edge goes to the first sub-region
+    // containing it (sub-regions 2 and 3 are in reverse order).
+    float x = _boundary.x + (_boundary.p / 2.0f);
+    float y = _boundary.y + (_boundary.q / 2.0f);
+    unsigned int result;
+    if(key.y > y) {
+        result = key.x >= x ? 2 : 3;
+    } else {
+        result = key.x > x ? 1 : 0;
+    }
+    return result;
+}
+
+unsigned long long Region::code(const glm::vec2 &key, unsigned int depth) const {
+    // Same arithmetic as 'divide' and 'index', without building sub-regions.
+    float x = _boundary.x;
+    float y = _boundary.y;
+    float width = _boundary.p;
+    float height = _boundary.q;
+    unsigned long long result = 0;
+    for(unsigned int i = 0; i < depth; ++i) {
+        width /= 2.0f;
+        height /= 2.0f;
+        float midX = x + width;
+        float midY = y + height;
+        // Branch-free: sub-regions are 0 (up left), 1 (up right), 2 (down right), 3 (down left).
+        unsigned int down = key.y > midY;
+        unsigned int right = down ? key.x >= midX : key.x > midX;
+        x = right ? midX : x;
+        y = down ? midY : y;
+        result = (result << 2) | (down << 1) | (right ^ down);
+    }
+    return result;
 }
 
 bool Region::contains(const glm::vec2 &key) const {
@@ -22,6 +64,22 @@ bool Region::contains(const glm::vec2 &key) const {
     return result;
 }
 
+double Region::distance(const glm::vec2 &key) const {
+    double dx = 0.0;
+    double dy = 0.0;
+    if(key.x < _boundary.x) {
+        dx = _boundary.x - key.x;
+    } else if(key.x > _boundary.x + _boundary.p) {
+        dx = key.x - (_boundary.x + _boundary.p);
+    }
+    if(key.y < _boundary.y) {
+        dy = _boundary.y - key.y;
+    } else if(key.y > _boundary.y + _boundary.q) {
+        dy = key.y - (_boundary.y + _boundary.q);
+    }
+    return std::sqrt((dx * dx) + (dy * dy));
+}
+
 void Region::diagnostic(const glm::vec2 &key) const {
     std::cout << "Test against " << key.x << ", " << key.y << std::endl;
     std::cout << "Boundary is [" << _boundary.x << " - "
@@ -66,6 +124,21 @@ bool Disc::contains(const glm::vec2& key) const {
     return ((dx * dx) + (dy * dy)) <= _sqradius;
 }
 
+void Disc::contains(const glm::vec2 *keys, unsigned int count, unsigned char *mask) const {
+    // Branch-free, so that the loop gets vectorized.
+    for(unsigned int i = 0; i < count; ++i) {
+        double dx = keys[i].x - _center.x;
+        double dy = keys[i].y - _center.y;
+        mask[i] = ((dx * dx) + (dy * dy)) <= _sqradius;
+    }
+}
+
+double Euclidean::distance(const glm::vec2 &a, const glm::vec2 &b) const {
+    double dx = a.x - b.x;
+    double dy = a.y - b.y;
+    return std::sqrt((dx * dx) + (dy * dy));
+}
+
 int Disc::contains(const Region& region) const {
     // Simplified version.
     glm::vec4 boundary = region.boundary();
@@ -78,3 +151,59 @@ int Disc::contains(const Region& region) const {
     // No full containment test.
 }
 
+void Summary::clear() {
+    _count = 0;
+    _keys = glm::vec2(0.0, 0.0);
+    _velocities = glm::vec2(0.0, 0.0);
+    _box = glm::vec4(0.0, 0.0, 0.0, 0.0);
+}
+
+void Summary::add(const glm::vec2 &key, const Element *element) {
+    if(0 == _count) {
+        _box = glm::vec4(key.x, key.y, key.x, key.y);
+    } else {
+        _box = glm::vec4(std::min(_box.x, key.x), std::min(_box.y, key.y),
+                std::max(_box.p, key.x), std::max(_box.q, key.y));
+    }
+    ++_count;
+    _keys += key;
+    _velocities += element->sample();
+}
+
+void Summary::remove(const glm::vec2 &key, const Element *element) {
+    --_count;
+    _keys -= key;
+    _velocities -= element->sampled();
+}
+
+void Summary::add(const Summary &other) {
+    if(other._count > 0) {
+        if(0 == _count) {
+            _box = other._box;
+        } else {
+            _box = glm::vec4(std::min(_box.x, other._box.x), std::min(_box.y, other._box.y),
+                    std::max(_box.p, other._box.p), std::max(_box.q, other._box.q));
+        }
+        _count += other._count;
+        _keys += other._keys;
+        _velocities += other._velocities;
+    }
+}
+
+glm::vec2 Summary::centroid() const {
+    return _count > 0 ? _keys / (float) _count : _keys;
+}
+
+glm::vec2 Summary::velocity() const {
+    return _count > 0 ? _velocities / (float) _count : _velocities;
+}
+
+bool Opening::open(const Region &region, const Summary &summary) const {
+    glm::vec4 boundary = region.boundary();
+    double size = std::max(boundary.p, boundary.q);
+    glm::vec2 centroid = summary.centroid();
+    double dx = centroid.x - _key.x;
+    double dy = centroid.y - _key.y;
+    // size / distance > theta, without the square root.
+    return size * size > _theta * _theta * ((dx * dx) + (dy * dy));
+}
@@ -15,11 +15,16 @@ class Region {
         inline Region &operator=(glm::vec4 bound) {
             _boundary = bound; return *this; }
 
-        inline unsigned int dimension() const { return 4; }
+        static const unsigned int FANOUT = 4;
+        inline unsigned int dimension() const { return FANOUT; }
+        unsigned int index(const glm::vec2 &) const;
+        unsigned long long code(const glm::vec2 &, unsigned int) const;
         const Region *divide() const;
+        void divide(Region *) const;
         inline glm::vec4 boundary() const { return _boundary; }
         bool contains(const glm::vec2 &) const;
         int contains(const Region &) const;
+        double distance(const glm::vec2 &) const;
         void diagnostic(const glm::vec2 &) const;
     private:
         glm::vec4 _boundary;
@@ -35,6 +40,7 @@ class Disc {
         }
         bool contains(const glm::vec2 &) const;
         int contains(const Region &) const;
+        void contains(const glm::vec2 *, unsigned int, unsigned char *) const;
     private:
         glm::vec2 _center;
         double _radius;
@@ -43,21 +49,73 @@ class Disc {
 
 
 
+class Euclidean {
+    public:
+        double distance(const glm::vec2 &, const glm::vec2 &) const;
+};
+
 class Element {
     public:
-        Element(glm::vec2 key, std::string name) : _key(key), _velocity(0, 0), _name(name) {}
+        Element(glm::vec2 key, std::string name) : _key(key), _velocity(0, 0), _sampled(0, 0), _name(name) {}
         const glm::vec2 &key() const { return _key; }
         void key(glm::vec2 &key) { _key = key; }
         const std::string &name() const { return _name; }
         inline void set(const glm::vec2 pos) { _key = pos; }
         void velocity(const glm::vec2 vel) { _velocity = vel; }
         const glm::vec2 &velocity() const { return _velocity; }
+        /**
+         * Record the velocity summed by the aggregates holding the element,
+         * so that they subtract the same value when it leaves.
+         * @return The recorded velocity.
+         */
+        const glm::vec2 &sample() const { _sampled = _velocity; return _sampled; }
+        /** @return The velocity recorded by the last 'sample'. */
+        const glm::vec2 &sampled() const { return _sampled; }
     private:
         glm::vec2 _key;
         glm::vec2 _velocity;
+        /** An element is in one leaf at a time, hence one recorded velocity. */
+        mutable glm::vec2 _sampled;
         std::string _name;
 };
 
+/**
+ * Node aggregate: count, centroid, mean velocity and bounding box of
+ * the elements. Velocities are sampled when elements are added, and
+ * removed as sampled, and the box only grows until the next refresh.
+ */
+class Summary {
+    public:
+        Summary() { clear(); }
+        void clear();
+        void add(const glm::vec2 &, const Element *);
+        void remove(const glm::vec2 &, const Element *);
+        void add(const Summary &);
+        unsigned int count() const { return _count; }
+        glm::vec2 centroid() const;
+        glm::vec2 velocity() const;
+        /** @return Bounding box, as (min x, min y, max x, max y). */
+        const glm::vec4 &box() const { return _box; }
+    private:
+        unsigned int _count;
+        glm::vec2 _keys;
+        glm::vec2 _velocities;
+        glm::vec4 _box;
+};
+
+/**
+ * Barnes-Hut opening criterion: a region is summarized when its size
+ * seen from the reference key is below an angle.
+ */
+class Opening {
+    public:
+        Opening(glm::vec2 key, double theta) : _key(key), _theta(theta) {}
+        bool open(const Region &, const Summary &) const;
+    private:
+        glm::vec2 _key;
+        double _theta;
+};
+
 class DepthVisitor {
     private:
         unsigned int _depth;
@@ -186,7 +244,7 @@ class MemoryInspector {
 
         void visit(Headless::Logic::SearchTree::Node<glm::vec2, Region, Element>* target,
                 const Region* region, Element** elements,
-                Headless::Logic::SearchTree::Node<glm::vec2, Region, Element>** nodes,
+                Headless::Logic::SearchTree::Node<glm::vec2, Region, Element>* nodes,
                 Headless::Logic::SearchTree::Node<glm::vec2, Region, Element>* parent,
                 bool leaf,
                 unsigned int count,
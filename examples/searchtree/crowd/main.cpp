@@ -18,6 +18,9 @@
  * This example is not meant to simulate flocking, but only "almost"
  * straight line going agents and how it affects the search tree.
  */
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 #include <random>
 
@@ -25,6 +28,7 @@
 #include <SFML/Graphics.hpp>
 
 #include <headless-logic/searchtree.hpp>
+#include <headless-logic/grid.hpp>
 #include "../common.hpp"
 
 int loadTexture(sf::Texture &texture, std::string path) {
@@ -78,11 +82,133 @@ class DisplayerVisitor {
 
 #define AGENT_COUNT 256
 #define AREA_SIZE 800
+#define NODE_CARDINALITY 3
+// Merge as soon as sub-nodes fit in a leaf. Lower it to add hysteresis.
+#define MERGE_THRESHOLD 3
+// Number of frames between two split/merge reports.
+#define REPORT_PERIOD 60
+#define PERCEPTION_RADIUS 32.0
+// Headless benchmark ('--benchmark'): frames per run and tree cardinality.
+#define BENCHMARK_FRAMES 10
+#define BENCHMARK_CARDINALITY 16
+
+/**
+ * Run a few fixed step frames over a spatial index and measure them.
+ * @param index Spatial index, filled with the pool.
+ * @param pool Agents.
+ * @param count Number of agents.
+ * @param side Side of the (square) area.
+ * @param mt Random generator.
+ * @return Mean frame time, in milliseconds.
+ */
+template <typename T> double simulate(T &index, Element **pool, unsigned int count,
+        double side, std::mt19937 &mt) {
+    std::uniform_real_distribution<double> posDist(0.0, side);
+    std::uniform_real_distribution<double> velDist(-128.0, 128.0);
+    glm::vec2 *targets = new glm::vec2[count];
+    Disc searchDisc;
+    double sec = 1.0 / 60.0;
+    auto start = std::chrono::steady_clock::now();
+    for(unsigned int frame = 0; frame < BENCHMARK_FRAMES; ++frame) {
+        for(unsigned int i = 0; i < count; ++i) {
+            glm::vec2 target = pool[i]->key();
+            glm::vec2 velocity = pool[i]->velocity();
+            target.x += velocity.x * sec;
+            target.y += velocity.y * sec;
+            if(target.x < 0 || target.y < 0 || target.x > side || target.y > side) {
+                target.x = posDist(mt);
+                target.y = posDist(mt);
+                pool[i]->velocity(glm::vec2(velDist(mt), velDist(mt)));
+            }
+            targets[i] = target;
+        }
+        index.moveAll(pool, targets, count);
+        for(unsigned int i = 0; i < count; ++i) {
+            searchDisc.set(pool[i]->key(), PERCEPTION_RADIUS);
+            glm::vec2 meanVelocity(0.0, 0.0);
+            unsigned int neighbors = 0;
+            auto accumulate = [&meanVelocity, &neighbors](Element *neighbor) {
+                meanVelocity += neighbor->velocity();
+                ++neighbors;
+                return true;
+            };
+            index.retrieve(searchDisc, accumulate);
+            if(neighbors > 0) {
+                meanVelocity.x /= (double) neighbors;
+                meanVelocity.y /= (double) neighbors;
+                pool[i]->velocity(meanVelocity);
+            }
+        }
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    delete []targets;
+    return elapsed.count() / BENCHMARK_FRAMES;
+}
+
+/**
+ * Compare frame times of the tree and the grid for growing crowds, at the
+ * density of the interactive mode.
+ * @return Exit status.
+ */
+int benchmark() {
+    typedef Headless::Logic::SearchTree::Node<glm::vec2, Region, Element> Tree;
+    typedef Headless::Logic::SearchTree::Grid<glm::vec2, Region, Element> Grid;
+    const unsigned int counts[] = { 10000, 100000, 1000000 };
+    std::mt19937 mt(42);
+    std::cout << "Agents, Tree (ms/frame), Grid (ms/frame)" << std::endl;
+    for(unsigned int count : counts) {
+        double side = AREA_SIZE * std::sqrt(count / (double) AGENT_COUNT);
+        std::uniform_real_distribution<double> posDist(0.0, side);
+        std::uniform_real_distribution<double> velDist(-128.0, 128.0);
+        Element **pool = new Element*[count];
+        glm::vec2 *positions = new glm::vec2[count];
+        glm::vec2 *velocities = new glm::vec2[count];
+        for(unsigned int i = 0; i < count; ++i) {
+            positions[i] = glm::vec2(posDist(mt), posDist(mt));
+            velocities[i] = glm::vec2(velDist(mt), velDist(mt));
+            pool[i] = new Element(positions[i], "Agent");
+            pool[i]->velocity(velocities[i]);
+        }
+        Region region(glm::vec4(0.0, 0.0, side, side));
+
+        std::mt19937 treeRandom(count);
+        Tree tree(&region, BENCHMARK_CARDINALITY);
+        tree.build(pool, count);
+        double treeTime = simulate(tree, pool, count, side, treeRandom);
+
+        // Same start for the grid, whose cells are at least as large as the
+        // perception radius.
+        for(unsigned int i = 0; i < count; ++i) {
+            pool[i]->key(positions[i]);
+            pool[i]->velocity(velocities[i]);
+        }
+        unsigned int depth = 0;
+        for(double cell = side; cell / 2.0 >= PERCEPTION_RADIUS; cell /= 2.0) {
+            ++depth;
+        }
+        std::mt19937 gridRandom(count);
+        Grid grid(&region, depth);
+        grid.build(pool, count);
+        double gridTime = simulate(grid, pool, count, side, gridRandom);
+
+        std::cout << count << ", " << treeTime << ", " << gridTime << std::endl;
+        for(unsigned int i = 0; i < count; ++i) {
+            delete pool[i];
+        }
+        delete []pool;
+        delete []positions;
+        delete []velocities;
+    }
+    return 0;
+}
 
 /**
  * Main procedure.
  */
-int main(void) {
+int main(int argc, char **argv) {
+    if(argc > 1 && 0 == std::strcmp(argv[1], "--benchmark")) {
+        return benchmark();
+    }
     sf::Vector2f textureOffset(32, 32);
 
     sf::Texture agentTexture;
@@ -101,10 +227,13 @@ int main(void) {
     visitor.set(&sprite, &window);
 
     Region region(glm::vec4(0.0, 0.0, AREA_SIZE, AREA_SIZE));
-    Headless::Logic::SearchTree::Node<glm::vec2, Region, Element> tree(&region, 3);
+    typedef Headless::Logic::SearchTree::Node<glm::vec2, Region, Element> Tree;
+    Tree tree(&region, NODE_CARDINALITY);
+    tree.policy(MERGE_THRESHOLD);
 
     Element **pool = new Element*[AGENT_COUNT];
-    Element **searchResult = new Element*[AGENT_COUNT];
+    // Leaf of each agent, so that moves start from there.
+    Tree **leaves = new Tree*[AGENT_COUNT];
     std::random_device randomDevice;
     std::mt19937 mt(randomDevice());
     std::uniform_real_distribution<double> posDist(0.0, AREA_SIZE);
@@ -114,7 +243,7 @@ int main(void) {
         pool[i] = new Element(glm::vec2(posDist(mt), posDist(mt)),
                 std::string("Agent#").append(std::to_string(i)));
         pool[i]->velocity(glm::vec2(velDist(mt), velDist(mt)));
-        tree.add(pool[i]);
+        leaves[i] = tree.add(pool[i]);
     }
 
     sf::Clock clock;
@@ -124,6 +253,10 @@ int main(void) {
 
     Disc searchDisc;
 
+    unsigned int frame = 0;
+    unsigned long splits = tree.splits();
+    unsigned long merges = tree.merges();
+
     while (window.isOpen()) {
         // Logic update
         elapsed = clock.restart();
@@ -141,15 +274,18 @@ int main(void) {
                 velocity.y = velDist(mt);
                 pool[i]->velocity(velocity);
             }
-            tree.move(pool[i], target);
+            tree.move(pool[i], target, leaves[i]);
 
             // Search neighbor and take mean velocity.
-            searchDisc.set(target, 32.0);
-            unsigned int count = tree.retrieve(searchDisc, searchResult, AGENT_COUNT);
+            searchDisc.set(target, PERCEPTION_RADIUS);
             glm::vec2 meanVelocity(0.0, 0.0);
-            for(unsigned int j = 0; j < count; ++j) {
-                meanVelocity += searchResult[j]->velocity();
-            }
+            unsigned int count = 0;
+            auto accumulate = [&meanVelocity, &count](Element *neighbor) {
+                meanVelocity += neighbor->velocity();
+                ++count;
+                return true;
+            };
+            tree.retrieve(searchDisc, accumulate);
             if(count > 0) {
                 meanVelocity.x /= (double) count;
                 meanVelocity.y /= (double) count;
@@ -157,6 +293,15 @@ int main(void) {
             }
         }
 
+        ++frame;
+        if(frame == REPORT_PERIOD) {
+            std::cout << "Splits/frame: " << (tree.splits() - splits) / (double) frame
+                << ", Merges/frame: " << (tree.merges() - merges) / (double) frame << std::endl;
+            splits = tree.splits();
+            merges = tree.merges();
+            frame = 0;
+        }
+
         // Event handling.
         sf::Event event;
         while (window.pollEvent(event)) {
@@ -197,6 +342,6 @@ int main(void) {
         delete pool[i];
     }
     delete []pool;
-    delete []searchResult;
+    delete []leaves;
     return 0;
 }
@@ -0,0 +1,155 @@
+#include <glm/glm.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "searchtree.hpp"
+#include "concurrent.hpp"
+#include "common.hpp"
+
+#define MT_NODE_CARDINALITY 16
+#define MT_POOL_SIZE 64000
+#define MT_AREA_SIZE 1000.0
+#define MT_SEARCH_RADIUS 10.0
+#define MT_BUFFER_SIZE 1024
+// Respawns between two publications.
+#define MT_PUBLISH_PERIOD 1000
+#define MT_DURATION_MS 1000
+#define MT_MAX_READERS 16
+
+typedef Headless::Logic::SearchTree::Node<glm::vec2, Region, Element> Tree;
+typedef Headless::Logic::SearchTree::Concurrent<glm::vec2, Region, Element> Shared;
+
+/**
+ * Run readers against a writer respawning elements and measure the
+ * query throughput.
+ * @param readers Number of reader threads.
+ * @param query Query procedure, given a search function and a buffer.
+ * @param respawn Writer procedure, given an element and its new key.
+ * @param publish Called by the writer every MT_PUBLISH_PERIOD respawns.
+ * @param pool Element pool.
+ * @return Queries per second.
+ */
+template <typename Q, typename W, typename P> double run(unsigned int readers, Q query,
+        W respawn, P publish, Element **pool) {
+    std::atomic<bool> running(true);
+    std::atomic<unsigned long> queries(0);
+    std::vector<std::thread> threads;
+    for(unsigned int t = 0; t < readers; ++t) {
+        threads.push_back(std::thread([&, t]() {
+            std::mt19937 mt(t);
+            std::uniform_real_distribution<double> dist(0.0, MT_AREA_SIZE);
+            Element **buffer = new Element*[MT_BUFFER_SIZE];
+            Disc disc;
+            unsigned long count = 0;
+            while(running.load(std::memory_order_relaxed)) {
+                disc.set(glm::vec2(dist(mt), dist(mt)), MT_SEARCH_RADIUS);
+                query(disc, buffer);
+                ++count;
+            }
+            queries += count;
+            delete []buffer;
+        }));
+    }
+    std::thread writer([&]() {
+        std::mt19937 mt(MT_MAX_READERS);
+        std::uniform_real_distribution<double> dist(0.0, MT_AREA_SIZE);
+        std::uniform_int_distribution<unsigned int> chooser(0, MT_POOL_SIZE - 1);
+        unsigned int respawns = 0;
+        while(running.load(std::memory_order_relaxed)) {
+            glm::vec2 key(dist(mt), dist(mt));
+            respawn(pool[chooser(mt)], key);
+            if(++respawns == MT_PUBLISH_PERIOD) {
+                publish();
+                respawns = 0;
+            }
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(MT_DURATION_MS));
+    running = false;
+    writer.join();
+    for(std::thread &thread : threads) {
+        thread.join();
+    }
+    return queries * 1000.0 / MT_DURATION_MS;
+}
+
+/**
+ * Compare a globally locked tree with the concurrent tree, for a growing
+ * number of readers and one writer.
+ * Usage: mtstresstest [max readers], MT_MAX_READERS by default. Readers
+ * beyond the hardware threads share cores, so scaling flattens there.
+ */
+int main(int argc, char **argv) {
+    unsigned int maxReaders = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : MT_MAX_READERS;
+    std::mt19937 mt(0);
+    std::uniform_real_distribution<double> dist(0.0, MT_AREA_SIZE);
+    Region region(glm::vec4(0.0, 0.0, MT_AREA_SIZE, MT_AREA_SIZE));
+
+    // One pool per tree, both trees locating elements by key.
+    Element **pool = new Element*[MT_POOL_SIZE];
+    Element **sharedPool = new Element*[MT_POOL_SIZE];
+    for(unsigned int i = 0; i < MT_POOL_SIZE; ++i) {
+        glm::vec2 key(dist(mt), dist(mt));
+        pool[i] = new Element(key, "Mt");
+        sharedPool[i] = new Element(key, "Mt");
+    }
+
+    Tree tree(&region, MT_NODE_CARDINALITY);
+    tree.build(pool, MT_POOL_SIZE);
+    std::mutex lock;
+    auto lockedQuery = [&](const Disc &disc, Element **buffer) {
+        std::lock_guard<std::mutex> guard(lock);
+        tree.retrieve(disc, buffer, MT_BUFFER_SIZE);
+    };
+    auto lockedRespawn = [&](Element *element, glm::vec2 &key) {
+        std::lock_guard<std::mutex> guard(lock);
+        tree.remove(element);
+        element->key(key);
+        tree.add(element);
+    };
+
+    Shared shared(&region, MT_NODE_CARDINALITY);
+    for(unsigned int i = 0; i < MT_POOL_SIZE; ++i) {
+        shared.add(sharedPool[i]);
+    }
+    shared.publish();
+    auto sharedQuery = [&](const Disc &disc, Element **buffer) {
+        shared.retrieve(disc, buffer, MT_BUFFER_SIZE);
+    };
+    auto sharedRespawn = [&](Element *element, glm::vec2 &key) {
+        shared.remove(element);
+        element->key(key);
+        shared.add(element);
+    };
+
+    std::cout << "Hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+    std::cout << "Readers, Locked (queries/s), Concurrent (queries/s), Locked speedup, Concurrent speedup"
+        << std::endl;
+    double lockedBase = 0.0;
+    double concurrentBase = 0.0;
+    for(unsigned int readers = 1; readers <= maxReaders; readers *= 2) {
+        double locked = run(readers, lockedQuery, lockedRespawn, []() {}, pool);
+        double concurrent = run(readers, sharedQuery, sharedRespawn,
+                [&]() { shared.publish(); }, sharedPool);
+        if(1 == readers) {
+            lockedBase = locked;
+            concurrentBase = concurrent;
+        }
+        std::cout << readers << ", " << locked << ", " << concurrent << ", "
+            << locked / lockedBase << ", " << concurrent / concurrentBase << std::endl;
+    }
+    std::cout << "Publications: " << shared.publications() << std::endl;
+
+    for(unsigned int i = 0; i < MT_POOL_SIZE; ++i) {
+        delete pool[i];
+        delete sharedPool[i];
+    }
+    delete []pool;
+    delete []sharedPool;
+    return 0;
+}
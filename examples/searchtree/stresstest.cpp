@@ -4,6 +4,8 @@
 #include <random>
 #include <chrono>
 #include "searchtree.hpp"
+#include "flattree.hpp"
+#include "mortontree.hpp"
 #include "common.hpp"
 
 #define STRESSTEST_NODE_CARDINALITY 16
@@ -12,6 +14,100 @@
 #define TEST_CHANGEKEY_OCCURENCE 10000000
 #define TEST_SEARCH_OCCURENCE 10000000
 #define TEST_FLUSHFILL_OCCURENCE 10000
+#define TEST_BUILD_OCCURENCE 10000
+#define MORTON_POOL_LIMIT 1024
+
+/**
+ * Stress a tree layout and print the timing columns.
+ * @param <T> Tree type.
+ * @param tree Empty tree.
+ * @param pool Element pool.
+ * @param poolSize Number of elements of the pool to use.
+ * @param mt Random engine.
+ * @param dist Position distribution.
+ */
+template <typename T> void stress(T &tree, Element **pool, unsigned int poolSize,
+        std::mt19937 &mt, std::uniform_real_distribution<double> &dist) {
+    auto start = std::chrono::steady_clock::now();
+    // - Inserting the whole pool in the tree.
+    for(unsigned int i = 0; i < poolSize; ++i) {
+        tree.add(pool[i]);
+    }
+    auto end = std::chrono::steady_clock::now();
+    auto diff = end - start;
+    std::cout << std::chrono::duration_cast<std::chrono::nanoseconds>(diff).count()
+        << ", ";
+
+    DepthVisitor dVisitor;
+    tree.visit(dVisitor);
+    std::cout << dVisitor.depth() << ", ";
+
+    // - Remove/Change Key/Add
+    std::uniform_real_distribution<double> elemChooser(0, poolSize);
+    start = std::chrono::steady_clock::now();
+    for(unsigned int i = 0; i < TEST_CHANGEKEY_OCCURENCE; ++i) {
+        Element *element = pool[(unsigned int) (elemChooser(mt))];
+        tree.remove(element);
+        element->set(glm::vec2(dist(mt), dist(mt)));
+        tree.add(element);
+    }
+    end = std::chrono::steady_clock::now();
+    diff = end - start;
+    std::cout << std::chrono::duration_cast<std::chrono::nanoseconds>(diff).count() / TEST_CHANGEKEY_OCCURENCE << ", ";
+
+    // Test on flush/removal.
+    start = std::chrono::steady_clock::now();
+    for(unsigned int i = 0; i < TEST_FLUSHFILL_OCCURENCE; ++i) {
+        for(unsigned int j = 0; j < poolSize; ++j) {
+            tree.remove(pool[j]);
+            pool[j]->set(glm::vec2(dist(mt), dist(mt)));
+        }
+        for(unsigned int j = 0; j < poolSize; ++j) {
+            tree.add(pool[j]);
+        }
+    }
+    end = std::chrono::steady_clock::now();
+    diff = end - start;
+    std::cout << std::chrono::duration_cast<std::chrono::nanoseconds>(diff).count() / TEST_FLUSHFILL_OCCURENCE << ", ";
+
+    // Test on bulk rebuild.
+    start = std::chrono::steady_clock::now();
+    for(unsigned int i = 0; i < TEST_BUILD_OCCURENCE; ++i) {
+        for(unsigned int j = 0; j < poolSize; ++j) {
+            pool[j]->set(glm::vec2(dist(mt), dist(mt)));
+        }
+        tree.build(pool, poolSize);
+    }
+    end = std::chrono::steady_clock::now();
+    diff = end - start;
+    std::cout << std::chrono::duration_cast<std::chrono::nanoseconds>(diff).count() / TEST_BUILD_OCCURENCE << ", ";
+
+    // Test on elements search.
+    Region shape;
+
+    Element **result = new Element*[ELEMENT_BUFFER_SIZE];
+    double searchSize[] = { 8.0, 16.0, 32.0, 64.0, 128.0 };
+
+    for(unsigned int j = 0; j < 5; ++j) {
+        double size = searchSize[j];
+        start = std::chrono::steady_clock::now();
+        for(unsigned int i = 0; i < TEST_SEARCH_OCCURENCE; ++i) {
+            shape = glm::vec4(dist(mt), dist(mt), size, size);
+            (void) tree.retrieve(shape, result, ELEMENT_BUFFER_SIZE);
+        }
+        end = std::chrono::steady_clock::now();
+        diff = end - start;
+        std::cout << std::chrono::duration_cast<std::chrono::nanoseconds>(diff).count() / TEST_CHANGEKEY_OCCURENCE << ", ";
+    }
+
+    start = std::chrono::steady_clock::now();
+    for(unsigned int i = 0; i < poolSize; ++i) {
+        tree.remove(pool[i]);
+    }
+    std::cout << std::chrono::duration_cast<std::chrono::nanoseconds>(diff).count()
+        << ", ";
+    delete []result;
+}
 
 /**
  * Main test procedure.
@@ -35,93 +131,48 @@ int main(void) {
     unsigned int testPoolSize[] = { 128, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768 };
     unsigned int testCardinality[] = { 8, 16, 32, 64 };
 
-    std::cout << "Node Cardinality, Element Count, Tree Fill, Depth, Remove/Change/Add, Flush/Fill, Find 8, Find 16, Find 32, Find 64, Find 128, Flush" << std::endl;
+    std::cout << "Layout, Node Cardinality, Element Count, Tree Fill, Depth, Remove/Change/Add, Flush/Fill, Build, Find 8, Find 16, Find 32, Find 64, Find 128, Flush, Allocator Hit Rate, Allocator Misses" << std::endl;
+
+    // Shared by all the trees, so that nodes released by one are recycled by the next.
+    Headless::Logic::SearchTree::Arena arena;
 
     for(unsigned int l = 0; l < 4; ++l) {
         unsigned int cardinality = testCardinality[l];
 
         for(unsigned int k = 0; k < 8; ++k) {
-            Headless::Logic::SearchTree::Node<glm::vec2, Region, Element> tree(&region, cardinality);
-            std::cout << cardinality << ", ";
-
             unsigned int poolSize = testPoolSize[k];
-            std::cout << poolSize << ", ";
+            {
+                unsigned long hits = arena.hits();
+                unsigned long misses = arena.misses();
+                Headless::Logic::SearchTree::Node<glm::vec2, Region, Element> tree(&region, cardinality,
+                        nullptr, &arena);
+                std::cout << "Node, " << cardinality << ", " << poolSize << ", ";
+                stress(tree, pool, poolSize, mt, dist);
+                hits = arena.hits() - hits;
+                misses = arena.misses() - misses;
+                std::cout << (100.0 * hits) / (hits + misses) << "%, " << misses << std::endl;
 
-            auto start = std::chrono::steady_clock::now();
-            // - Inserting the whole pool in the tree.
-            for(unsigned int i = 0; i < poolSize; ++i) {
-                tree.add(pool[i]);
-            }
-            auto end = std::chrono::steady_clock::now();
-            auto diff = end - start;
-            std::cout << std::chrono::duration_cast<std::chrono::nanoseconds>(diff).count()
-                << ", ";
-    
-            DepthVisitor dVisitor;
-            tree.visit(dVisitor);
-            std::cout << dVisitor.depth() << ", ";
-    
-            // - Remove/Change Key/Add
-            std::uniform_real_distribution<double> elemChooser(0, poolSize);
-            start = std::chrono::steady_clock::now();
-            for(unsigned int i = 0; i < TEST_CHANGEKEY_OCCURENCE; ++i) {
-                Element *element = pool[(unsigned int) (elemChooser(mt))];
-                tree.remove(element);
-                element->set(glm::vec2(dist(mt), dist(mt)));
-                tree.add(element);
-            }
-            end = std::chrono::steady_clock::now();
-            diff = end - start;
-            std::cout << std::chrono::duration_cast<std::chrono::nanoseconds>(diff).count() / TEST_CHANGEKEY_OCCURENCE << ", ";
-    
-            // Test on flush/removal.
-            start = std::chrono::steady_clock::now();
-            for(unsigned int i = 0; i < TEST_FLUSHFILL_OCCURENCE; ++i) {
-                for(unsigned int j = 0; j < poolSize; ++j) {
-                    tree.remove(pool[j]);
-                    pool[j]->set(glm::vec2(dist(mt), dist(mt)));
-                }
-                for(unsigned int j = 0; j < poolSize; ++j) {
-                    tree.add(pool[j]);
-                }
+#ifdef TREE_DEBUG
+                MemoryInspector memoryInspector;
+                std::cout << "digraph G {" << std::endl;
+                memoryInspector.init();
+                tree.deepVisit(memoryInspector);
+                std::cout << "}" << std::endl;
+#endif
             }
-            end = std::chrono::steady_clock::now();
-            diff = end - start;
-            std::cout << std::chrono::duration_cast<std::chrono::nanoseconds>(diff).count() / TEST_FLUSHFILL_OCCURENCE << ", ";
-    
-            // Test on elements search.
-            Region shape;
-    
-            Element **result = new Element*[ELEMENT_BUFFER_SIZE];
-            double searchSize[] = { 8.0, 16.0, 32.0, 64.0, 128.0 };
-    
-            for(unsigned int j = 0; j < 5; ++j) {
-                double size = searchSize[j];
-                start = std::chrono::steady_clock::now();
-                for(unsigned int i = 0; i < TEST_SEARCH_OCCURENCE; ++i) {
-                    shape = glm::vec4(dist(mt), dist(mt), size, size);
-                    (void) tree.retrieve(shape, result, ELEMENT_BUFFER_SIZE);
-                }
-                end = std::chrono::steady_clock::now();
-                diff = end - start;
-                std::cout << std::chrono::duration_cast<std::chrono::nanoseconds>(diff).count() / TEST_CHANGEKEY_OCCURENCE << ", ";
+            {
+                Headless::Logic::SearchTree::FlatTree<glm::vec2, Region, Element> tree(&region, cardinality);
+                std::cout << "Flat, " << cardinality << ", " << poolSize << ", ";
+                stress(tree, pool, poolSize, mt, dist);
+                std::cout << "-, -" << std::endl;
             }
-    
-            start = std::chrono::steady_clock::now();
-            for(unsigned int i = 0; i < poolSize; ++i) {
-                tree.remove(pool[i]);
+            // Single insertions and removals are linear, larger pools take ages.
+            if(poolSize <= MORTON_POOL_LIMIT) {
+                Headless::Logic::SearchTree::MortonTree<glm::vec2, Region, Element> tree(&region, cardinality);
+                std::cout << "Morton, " << cardinality << ", " << poolSize << ", ";
+                stress(tree, pool, poolSize, mt, dist);
+                std::cout << "-, -" << std::endl;
             }
-            std::cout << std::chrono::duration_cast<std::chrono::nanoseconds>(diff).count()
-                << std::endl;
-            delete []result;
-
-#ifdef TREE_DEBUG
-            MemoryInspector memoryInspector;
-            std::cout << "digraph G {" << std::endl;
-            memoryInspector.init();
-            tree.deepVisit(memoryInspector);
-            std::cout << "}" << std::endl;
-#endif
         }
     }
     // Clean-up.
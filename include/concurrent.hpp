@@ -0,0 +1,382 @@
+/*
+ * Copyright 2016 Stoned Xander
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HEADLESS_LOGIC_CONCURRENT
+#define HEADLESS_LOGIC_CONCURRENT
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "searchtree.hpp"
+
+// Readers querying at once, more wait for a free slot.
+#define CONCURRENT_READER_SLOTS 64
+#define CONCURRENT_LINE_SIZE 64
+
+namespace Headless {
+    namespace Logic {
+        namespace SearchTree {
+
+            /**
+             * Concurrent tree, read-copy-update style.
+             *
+             * Readers query an immutable snapshot of the tree and never take
+             * a lock: a reader claims one of CONCURRENT_READER_SLOTS slots
+             * (on its own cache line, picked from the thread id) with a
+             * compare-and-swap, and publishes in it the snapshot it reads,
+             * hazard pointer style. Readers only share the current snapshot
+             * pointer, which they load, and wait only when all slots are taken.
+             * Writers update a pending set of elements, serialized by a mutex,
+             * and 'publish' it as a new snapshot built in one pass. Former
+             * snapshots are retired and freed by a later publication once no
+             * slot holds them, so merges, splits and rebuilds never free nodes
+             * a reader may still walk.
+             *
+             * Snapshots rely on the trees key cache, so readers never read
+             * element keys. Elements themselves are shared: sinks reading
+             * element data updated by writers must synchronize on their own.
+             * @param <K> Key concept. See 'Node'.
+             * @param <R> Region concept. See 'Node'.
+             * @param <E> Element concept. See 'Node'.
+             * @param <T> Snapshot tree type, built with 'build'. Defaults to 'Node'.
+             */
+            template <typename K, typename R, typename E, typename T = Node<K, R, E> > class Concurrent {
+                private:
+                    /**
+                     * Reader slot, alone on its cache line.
+                     */
+                    class Slot {
+                        public:
+                            Slot() : hazard(nullptr), busy(false) {}
+                            /** Snapshot read through this slot. */
+                            std::atomic<T*> hazard;
+                            /** Claimed by a reader. */
+                            std::atomic<bool> busy;
+                        private:
+                            char _padding[CONCURRENT_LINE_SIZE - sizeof(std::atomic<T*>) -
+                                sizeof(std::atomic<bool>)];
+                    };
+                public:
+                    /**
+                     * Default visitor.
+                     */
+                    typedef typename T::Visitor Visitor;
+
+                    /**
+                     * Protected access to a snapshot. The snapshot is not freed as
+                     * long as the guard lives. Guards are movable, not copyable,
+                     * and must not outlive the tree.
+                     */
+                    class Snapshot {
+                        public:
+                            Snapshot(Snapshot&& other) : _slot(other._slot), _tree(other._tree) {
+                                other._slot = nullptr;
+                            }
+                            ~Snapshot() {
+                                if(nullptr != _slot) {
+                                    _slot->hazard.store(nullptr, std::memory_order_release);
+                                    _slot->busy.store(false, std::memory_order_release);
+                                }
+                            }
+                            T* operator->() const { return _tree; }
+                            T& operator*() const { return *_tree; }
+                            T* get() const { return _tree; }
+                        private:
+                            friend class Concurrent;
+                            Snapshot(Slot* slot, T* tree) : _slot(slot), _tree(tree) {}
+                            Snapshot(const Snapshot&) = delete;
+                            Snapshot& operator=(const Snapshot&) = delete;
+                        private:
+                            Slot* _slot;
+                            T* _tree;
+                    };
+                public:
+                    /**
+                     * Constructor. The first snapshot is empty.
+                     * @param region Region covered by the tree.
+                     * @param cardinality Snapshot tree construction parameter.
+                     */
+                    Concurrent(const R* region, unsigned int cardinality = DEFAULT_CARD);
+                    /**
+                     * Destructor. No reader may be running.
+                     */
+                    ~Concurrent();
+                    /**
+                     * Add an element. Visible to readers once published.
+                     * @param element Element to add.
+                     * @return false if the element key is outside the region or
+                     * the element is already stored.
+                     */
+                    bool add(E* element);
+                    /**
+                     * Remove an element. Still visible to readers until published.
+                     * @param element Element to remove.
+                     */
+                    void remove(E* element);
+                    /**
+                     * Move an element. Readers see the former key until published.
+                     * @param element Element to move.
+                     * @param key Target key.
+                     */
+                    void move(E* element, K& key);
+                    /**
+                     * Publish the pending elements as the snapshot seen by readers.
+                     */
+                    void publish();
+                    /**
+                     * Retrieve elements from the current snapshot. See 'Node::retrieve'.
+                     * Can be called concurrently with any other method.
+                     * @param func Search function.
+                     * @param buffer Storage for eligible elements.
+                     * @param size Size of the buffer.
+                     * @param visitor Optional visitor.
+                     * @param overflow Optional overflow flag.
+                     * @return Number of elements stored in the buffer.
+                     */
+                    template <typename S, typename V = Visitor> unsigned int retrieve(const S& func,
+                            E** buffer, unsigned int size, V* visitor = nullptr,
+                            bool* overflow = nullptr) const {
+                        return snapshot()->retrieve(func, buffer, size, visitor, overflow);
+                    }
+                    /**
+                     * Stream elements of the current snapshot to a sink. See 'Node::retrieve'.
+                     * Can be called concurrently with any other method.
+                     * @param func Search function.
+                     * @param sink Element consumer.
+                     * @param visitor Optional visitor.
+                     * @return false if the sink stopped the search.
+                     */
+                    template <typename S, typename C, typename V = Visitor> bool retrieve(const S& func,
+                            C& sink, V* visitor = nullptr) const {
+                        return snapshot()->retrieve(func, sink, visitor);
+                    }
+                    /**
+                     * Visit the current snapshot. See 'Node::visit'.
+                     * Can be called concurrently with any other method.
+                     * @param visitor Visitor.
+                     */
+                    template <typename V> void visit(V& visitor) const {
+                        snapshot()->visit(visitor);
+                    }
+                    /**
+                     * Get the current snapshot, kept alive as long as the guard is.
+                     * Snapshots must only be read: use it for a consistent series of queries.
+                     * @return Current snapshot guard.
+                     */
+                    Snapshot snapshot() const;
+                    /**
+                     * @return Number of publications so far.
+                     */
+                    unsigned long publications() const;
+
+                private:
+                    Concurrent(const Concurrent&) = delete;
+                    Concurrent& operator=(const Concurrent&) = delete;
+
+                    typedef std::unordered_map<E*, std::size_t> Positions;
+                    /**
+                     * Remove a pending element, the lock being held.
+                     * @param found Element position.
+                     */
+                    void detach(typename Positions::iterator found);
+                    /**
+                     * Free the retired snapshots no reader holds, the lock being held.
+                     */
+                    void reclaim();
+
+                private:
+                    /** Region covered by the tree. */
+                    R                                   _region;
+                    /** Snapshot tree construction parameter. */
+                    unsigned int                        _cardinality;
+                    /** Pending elements. */
+                    std::vector<E*>                     _pending;
+                    /** Position of each pending element. */
+                    Positions                           _positions;
+                    /** Publication staging area, 'build' reorders elements. */
+                    std::vector<E*>                     _staging;
+                    /** Current snapshot. */
+                    std::atomic<T*>                     _snapshot;
+                    /** Snapshots replaced, still possibly read. */
+                    std::vector<T*>                     _retired;
+                    /** Reader slots storage. */
+                    void*                               _memory;
+                    /** Reader slots, aligned on cache lines. */
+                    Slot*                               _slots;
+                    /** Publication count. */
+                    unsigned long                       _publications;
+                    /** Writers lock. */
+                    mutable std::mutex                  _mutex;
+            };
+
+            template <typename K, typename R, typename E, typename T>
+                Concurrent<K, R, E, T>::Concurrent(const R* region, unsigned int cardinality) :
+                    _region(*region), _cardinality(cardinality),
+                    _snapshot(new T(&_region, _cardinality)), _publications(0) {
+                        static_assert(sizeof(Slot) == CONCURRENT_LINE_SIZE, "Slots fill a cache line.");
+                        _memory = ::operator new(CONCURRENT_READER_SLOTS * sizeof(Slot) + CONCURRENT_LINE_SIZE);
+                        std::size_t address = reinterpret_cast<std::size_t>(_memory);
+                        address = (address + CONCURRENT_LINE_SIZE - 1) & ~static_cast<std::size_t>(CONCURRENT_LINE_SIZE - 1);
+                        _slots = reinterpret_cast<Slot*>(address);
+                        for(unsigned int i = 0; i < CONCURRENT_READER_SLOTS; ++i) {
+                            new (_slots + i) Slot();
+                        }
+                    }
+
+            template <typename K, typename R, typename E, typename T>
+                Concurrent<K, R, E, T>::~Concurrent() {
+                    delete _snapshot.load();
+                    for(T* retired : _retired) {
+                        delete retired;
+                    }
+                    for(unsigned int i = 0; i < CONCURRENT_READER_SLOTS; ++i) {
+                        _slots[i].~Slot();
+                    }
+                    ::operator delete(_memory);
+                }
+
+            template <typename K, typename R, typename E, typename T>
+                typename Concurrent<K, R, E, T>::Snapshot Concurrent<K, R, E, T>::snapshot() const {
+                    // Claim a slot, starting from one picked by the thread id
+                    // so that readers seldom collide.
+                    unsigned int index = std::hash<std::thread::id>()(std::this_thread::get_id())
+                        % CONCURRENT_READER_SLOTS;
+                    Slot* slot = _slots + index;
+                    bool expected = false;
+                    while(slot->busy.load(std::memory_order_relaxed) ||
+                            !slot->busy.compare_exchange_weak(expected, true, std::memory_order_acquire)) {
+                        expected = false;
+                        index = (index + 1) % CONCURRENT_READER_SLOTS;
+                        slot = _slots + index;
+                        if(0 == index) {
+                            std::this_thread::yield();
+                        }
+                    }
+                    // Announce the snapshot, then check it is still current: a
+                    // writer retiring it afterwards sees the announcement.
+                    T* tree = _snapshot.load();
+                    for(;;) {
+                        slot->hazard.store(tree);
+                        T* current = _snapshot.load();
+                        if(current == tree) {
+                            break;
+                        }
+                        tree = current;
+                    }
+                    return Snapshot(slot, tree);
+                }
+
+            template <typename K, typename R, typename E, typename T>
+                bool Concurrent<K, R, E, T>::add(E* element) {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    bool result = _region.contains(element->key())
+                        && _positions.find(element) == _positions.end();
+                    if(result) {
+                        _positions[element] = _pending.size();
+                        _pending.push_back(element);
+                    }
+                    return result;
+                }
+
+            template <typename K, typename R, typename E, typename T>
+                void Concurrent<K, R, E, T>::remove(E* element) {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    auto found = _positions.find(element);
+                    if(found != _positions.end()) {
+                        detach(found);
+                    }
+                }
+
+            template <typename K, typename R, typename E, typename T>
+                void Concurrent<K, R, E, T>::detach(typename Positions::iterator found) {
+                    std::size_t position = found->second;
+                    E* last = _pending.back();
+                    _positions.erase(found);
+                    if(last != _pending[position]) {
+                        _pending[position] = last;
+                        _positions[last] = position;
+                    }
+                    _pending.pop_back();
+                }
+
+            template <typename K, typename R, typename E, typename T>
+                void Concurrent<K, R, E, T>::move(E* element, K& key) {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    auto found = _positions.find(element);
+                    bool inside = _region.contains(key);
+                    element->key(key);
+                    // As the trees do, elements leaving the region are dropped and
+                    // elements entering it are added.
+                    if(found != _positions.end() && !inside) {
+                        detach(found);
+                    } else if(found == _positions.end() && inside) {
+                        _positions[element] = _pending.size();
+                        _pending.push_back(element);
+                    }
+                }
+
+            template <typename K, typename R, typename E, typename T>
+                void Concurrent<K, R, E, T>::publish() {
+                    T* next = new T(&_region, _cardinality);
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    _staging.assign(_pending.begin(), _pending.end());
+                    next->build(_staging.data(), static_cast<unsigned int>(_staging.size()));
+                    ++_publications;
+                    // Readers holding the former snapshot keep it alive.
+                    _retired.push_back(_snapshot.exchange(next));
+                    reclaim();
+                }
+
+            template <typename K, typename R, typename E, typename T>
+                void Concurrent<K, R, E, T>::reclaim() {
+                    std::vector<T*> held;
+                    for(unsigned int i = 0; i < CONCURRENT_READER_SLOTS; ++i) {
+                        T* hazard = _slots[i].hazard.load();
+                        if(nullptr != hazard) {
+                            held.push_back(hazard);
+                        }
+                    }
+                    std::size_t kept = 0;
+                    for(T* retired : _retired) {
+                        bool used = false;
+                        for(T* hazard : held) {
+                            used = used || hazard == retired;
+                        }
+                        if(used) {
+                            _retired[kept++] = retired;
+                        } else {
+                            delete retired;
+                        }
+                    }
+                    _retired.resize(kept);
+                }
+
+            template <typename K, typename R, typename E, typename T>
+                unsigned long Concurrent<K, R, E, T>::publications() const {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    return _publications;
+                }
+
+        } // Namespace 'SearchTree'
+    } // Namespace 'Logic'
+} // Namespace 'Headless'
+
+#endif
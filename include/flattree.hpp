@@ -0,0 +1,617 @@
+/*
+ * Copyright 2016 Stoned Xander
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HEADLESS_LOGIC_FLAT_TREE
+#define HEADLESS_LOGIC_FLAT_TREE
+
+#include <cstring>
+
+// Concepts and defaults are shared with the linked tree.
+#include "searchtree.hpp"
+
+namespace Headless {
+    namespace Logic {
+        namespace SearchTree {
+
+            /**
+             * Flat Search Tree.
+             *
+             * Same operations and concepts as 'Node', but the whole tree lives
+             * in one contiguous array of cells. Sub-cells of a cell are stored
+             * contiguously and are referred to by index. Element slots are
+             * stored inline, right after each cell header. Regions are stored
+             * in a parallel array, so that sibling regions are contiguous too.
+             *
+             * The region dimension is assumed to be the same for the whole tree.
+             * In addition to the 'Node' requirements, regions must be default
+             * constructible and assignable.
+             * @param <K> Key concept. See 'Node'.
+             * @param <R> Region concept. See 'Node'.
+             * @param <E> Element concept. See 'Node'.
+             */
+            template <typename K, typename R, typename E> class FlatTree {
+                public:
+                    /**
+                     * Default visitor.
+                     */
+                    class Visitor {
+                        public:
+                            void enter(const R&) {}
+                            void exit(const R&) {}
+                            void inspect(E**, unsigned int) {}
+                            void inspect(E*) {}
+                    };
+                public:
+                    /**
+                     * Constructor.
+                     * @param region Region covered by the tree.
+                     * @param cardinality Maximum number of elements per leaf.
+                     */
+                    FlatTree(const R* region, unsigned int cardinality = DEFAULT_CARD);
+                    /**
+                     * Destructor.
+                     */
+                    ~FlatTree();
+                    /**
+                     * Add an element.
+                     * @param element Pointer to the element to add.
+                     * @return false if the element key is outside the region.
+                     */
+                    bool add(E* element);
+                    /**
+                     * Remove an element.
+                     * @param element Pointer to the element instance to remove.
+                     */
+                    void remove(E* element);
+                    /**
+                     * Move an element within the tree.
+                     * @param element Element to be moved.
+                     * @param key Target key.
+                     */
+                    void move(E* element, K &key);
+                    /**
+                     * Move a batch of elements within the tree.
+                     * @param elements Elements to be moved.
+                     * @param keys Target keys, one per element.
+                     * @param count Number of elements.
+                     */
+                    void moveAll(E** elements, K* keys, unsigned int count);
+                    /**
+                     * Replace the content of the tree with a batch of elements.
+                     * See 'Node::build'.
+                     * @param elements Elements to store. The array is reordered.
+                     * @param count Number of elements.
+                     */
+                    void build(E** elements, unsigned int count);
+                    /**
+                     * Retrieve elements matching a search function.
+                     * @param func Search function. See 'Node::retrieve'.
+                     * @param buffer Storage for eligible elements.
+                     * @param size Size of the buffer.
+                     * @param visitor Optional visitor.
+                     * @param overflow Optional flag, set to true if there are more
+                     * eligible elements than 'size'.
+                     * @return Number of elements stored in the buffer.
+                     */
+                    template <typename S, typename V = Visitor> unsigned int retrieve(const S& func,
+                            E** buffer, unsigned int size, V* visitor = nullptr,
+                            bool* overflow = nullptr) const;
+                    /**
+                     * Stream the elements matching a search function to a sink.
+                     * See 'Node::retrieve'.
+                     * @param func Search function.
+                     * @param sink Element consumer.
+                     * @param visitor Optional visitor.
+                     * @return false if the sink stopped the search.
+                     */
+                    template <typename S, typename C, typename V = Visitor> bool retrieve(const S& func,
+                            C& sink, V* visitor = nullptr) const;
+                    /**
+                     * Run a batch of retrievals, spread over threads when compiled
+                     * with OpenMP. See 'Node::retrieveAll'.
+                     * @param queries Query provider.
+                     * @param count Number of queries.
+                     * @param size Size of the per-thread buffers.
+                     * @param consumer Result consumer.
+                     */
+                    template <typename Q, typename C> void retrieveAll(const Q& queries,
+                            unsigned int count, unsigned int size, C& consumer) const;
+                    /**
+                     * Recursive visit of the tree. See 'Node::visit'.
+                     * @param visitor Visitor.
+                     */
+                    template <typename V> void visit(V& visitor);
+
+                private:
+                    FlatTree(const FlatTree&) = delete;
+                    FlatTree& operator=(const FlatTree&) = delete;
+
+                    /**
+                     * Cell header. Followed by '_cardinality' element slots.
+                     */
+                    struct Cell {
+                        /** Index of the first sub-cell. Meaningless if leaf. */
+                        unsigned int first;
+                        /** Index of the parent cell. */
+                        unsigned int parent;
+                        /** Element or sub-cell count. */
+                        unsigned int count;
+                        /** Leaf indicator. */
+                        unsigned int leaf;
+                    };
+
+                    /** Invalid cell index. */
+                    static const unsigned int NIL = ~0u;
+
+                    Cell* cell(unsigned int index) const {
+                        return reinterpret_cast<Cell*>(_cells + (index * _stride));
+                    }
+                    E** slots(unsigned int index) const {
+                        return reinterpret_cast<E**>(_cells + (index * _stride) + sizeof(Cell));
+                    }
+                    /**
+                     * Find the leaf that can possibly host the key.
+                     * @param key Key to locate.
+                     * @return Leaf index or NIL if the key is outside the tree region.
+                     */
+                    unsigned int find(const K& key) const;
+                    /**
+                     * Turn a full leaf into a node.
+                     * @param index Leaf index.
+                     */
+                    void split(unsigned int index);
+                    /**
+                     * Turn a node whose sub-cells are leaves back into a leaf.
+                     * @param index Node index.
+                     */
+                    void merge(unsigned int index);
+                    /**
+                     * Store a batch of elements under an empty leaf.
+                     * @param index Leaf index.
+                     * @param elements Elements, all contained by the leaf region.
+                     * @param count Number of elements.
+                     */
+                    void fill(unsigned int index, E** elements, unsigned int count);
+                    /**
+                     * Get a block of sub-cells, from the free list or by growing storage.
+                     * @return Index of the first cell of the block.
+                     */
+                    unsigned int reserve();
+                    /**
+                     * Divide a region into the specified storage.
+                     */
+                    void divide(const R& region, R* target, std::false_type);
+                    void divide(const R& region, R* target, std::true_type);
+
+                    template <typename S, typename C, typename V> bool retrieve(unsigned int index,
+                            const S& func, C& sink, V* visitor) const;
+                    template <typename C, typename V> bool fetch(unsigned int index,
+                            C& sink, V* visitor) const;
+                    template <typename V> void visit(unsigned int index, V& visitor);
+
+                private:
+                    /** Cells and their inline slots. */
+                    unsigned char*           _cells;
+                    /** Regions, by cell index. */
+                    R*                       _regions;
+                    /** Size of a cell and its slots (in bytes). */
+                    unsigned int             _stride;
+                    /** Number of used cells. */
+                    unsigned int             _size;
+                    /** Number of allocated cells. */
+                    unsigned int             _capacity;
+                    /** First free block of sub-cells. NIL if none. */
+                    unsigned int             _free;
+                    /** Region subdivision. */
+                    unsigned int             _dimension;
+                    /** Maximum number of elements per leaf. */
+                    unsigned int             _cardinality;
+            };
+
+            template <typename K, typename R, typename E>
+                FlatTree<K, R, E>::FlatTree(const R* region, unsigned int cardinality) :
+                    _stride(sizeof(Cell) + cardinality * sizeof(E*)), _size(1),
+                    _free(NIL), _dimension(region->dimension()), _cardinality(cardinality) {
+                        _capacity = 1 + _dimension * DEFAULT_CARD;
+                        _cells = new unsigned char[_capacity * _stride];
+                        _regions = new R[_capacity];
+                        _regions[0] = *region;
+                        Cell* root = cell(0);
+                        root->first = 0;
+                        root->parent = NIL;
+                        root->count = 0;
+                        root->leaf = 1;
+                    }
+
+            template <typename K, typename R, typename E>
+                FlatTree<K, R, E>::~FlatTree() {
+                    delete []_cells;
+                    delete []_regions;
+                }
+
+            template <typename K, typename R, typename E>
+                void FlatTree<K, R, E>::divide(const R& region, R* target, std::false_type) {
+                    const R* regions = region.divide();
+                    for(unsigned int i = 0; i < _dimension; ++i) {
+                        target[i] = regions[i];
+                    }
+                    delete []regions;
+                }
+
+            template <typename K, typename R, typename E>
+                void FlatTree<K, R, E>::divide(const R& region, R* target, std::true_type) {
+                    region.divide(target);
+                }
+
+            template <typename K, typename R, typename E>
+                unsigned int FlatTree<K, R, E>::reserve() {
+                    unsigned int result;
+                    if(NIL != _free) {
+                        result = _free;
+                        _free = cell(result)->first;
+                    } else {
+                        if(_size + _dimension > _capacity) {
+                            unsigned int capacity = _capacity * 2;
+                            unsigned char* cells = new unsigned char[capacity * _stride];
+                            std::memcpy(cells, _cells, _size * _stride);
+                            delete []_cells;
+                            _cells = cells;
+                            R* regions = new R[capacity];
+                            for(unsigned int i = 0; i < _size; ++i) {
+                                regions[i] = _regions[i];
+                            }
+                            delete []_regions;
+                            _regions = regions;
+                            _capacity = capacity;
+                        }
+                        result = _size;
+                        _size += _dimension;
+                    }
+                    return result;
+                }
+
+            template <typename K, typename R, typename E>
+                unsigned int FlatTree<K, R, E>::find(const K& key) const {
+                    unsigned int result = NIL;
+                    if(_regions[0].contains(key)) {
+                        result = 0;
+                        const Cell* current = cell(0);
+                        while(!current->leaf) {
+                            unsigned int first = current->first;
+                            unsigned int next = NIL;
+                            for(unsigned int i = 0; i < _dimension; ++i) {
+                                if(_regions[first + i].contains(key)) {
+                                    next = first + i;
+                                    break;
+                                }
+                            }
+                            if(NIL == next) {
+                                result = NIL;
+                                break;
+                            }
+                            result = next;
+                            current = cell(result);
+                        }
+                    }
+                    return result;
+                }
+
+            template <typename K, typename R, typename E>
+                void FlatTree<K, R, E>::split(unsigned int index) {
+                    // Growing the storage invalidates cell pointers.
+                    unsigned int first = reserve();
+                    divide(_regions[index], _regions + first,
+                            std::integral_constant<bool, Divisible<R>::value>());
+                    Cell* node = cell(index);
+                    E** toShare = slots(index);
+                    unsigned int shareCount = node->count;
+                    for(unsigned int i = 0; i < _dimension; ++i) {
+                        unsigned int child = first + i;
+                        Cell* target = cell(child);
+                        E** elements = slots(child);
+                        target->parent = index;
+                        target->leaf = 1;
+                        target->count = 0;
+                        const R& region = _regions[child];
+                        for(unsigned int j = 0; j < shareCount;) {
+                            if(region.contains(toShare[j]->key())) {
+                                elements[target->count] = toShare[j];
+                                ++target->count;
+                                --shareCount;
+                                toShare[j] = toShare[shareCount];
+                            } else {
+                                ++j;
+                            }
+                        }
+                    }
+                    node->leaf = 0;
+                    node->first = first;
+                    node->count = _dimension;
+                }
+
+            template <typename K, typename R, typename E>
+                void FlatTree<K, R, E>::merge(unsigned int index) {
+                    Cell* node = cell(index);
+                    E** elements = slots(index);
+                    unsigned int first = node->first;
+                    unsigned int count = 0;
+                    for(unsigned int i = 0; i < _dimension; ++i) {
+                        const Cell* target = cell(first + i);
+                        E** src = slots(first + i);
+                        for(unsigned int j = 0; j < target->count; ++j) {
+                            elements[count] = src[j];
+                            ++count;
+                        }
+                    }
+                    node->count = count;
+                    node->leaf = 1;
+                    // Give the block back.
+                    cell(first)->first = _free;
+                    _free = first;
+                }
+
+            template <typename K, typename R, typename E>
+                void FlatTree<K, R, E>::fill(unsigned int index, E** elements, unsigned int count) {
+                    if(count <= _cardinality) {
+                        Cell* leaf = cell(index);
+                        leaf->leaf = 1;
+                        leaf->count = count;
+                        E** dest = slots(index);
+                        for(unsigned int i = 0; i < count; ++i) {
+                            dest[i] = elements[i];
+                        }
+                    } else {
+                        unsigned int first = reserve();
+                        divide(_regions[index], _regions + first,
+                                std::integral_constant<bool, Divisible<R>::value>());
+                        Cell* node = cell(index);
+                        node->leaf = 0;
+                        node->first = first;
+                        node->count = _dimension;
+                        E** begin = elements;
+                        E** end = elements + count;
+                        for(unsigned int i = 0; i < _dimension; ++i) {
+                            unsigned int child = first + i;
+                            cell(child)->parent = index;
+                            const R& region = _regions[child];
+                            E** cur = begin;
+                            for(E** it = begin; it < end; ++it) {
+                                if(region.contains((*it)->key())) {
+                                    E* swap = *cur;
+                                    *cur = *it;
+                                    *it = swap;
+                                    ++cur;
+                                }
+                            }
+                            // May grow the storage.
+                            fill(child, begin, cur - begin);
+                            begin = cur;
+                        }
+                    }
+                }
+
+            template <typename K, typename R, typename E>
+                void FlatTree<K, R, E>::build(E** elements, unsigned int count) {
+                    // Start over with a lone root.
+                    _size = 1;
+                    _free = NIL;
+                    unsigned int inside = 0;
+                    for(unsigned int i = 0; i < count; ++i) {
+                        if(_regions[0].contains(elements[i]->key())) {
+                            E* swap = elements[inside];
+                            elements[inside] = elements[i];
+                            elements[i] = swap;
+                            ++inside;
+                        }
+                    }
+                    fill(0, elements, inside);
+                }
+
+            template <typename K, typename R, typename E>
+                bool FlatTree<K, R, E>::add(E* element) {
+                    const K& key = element->key();
+                    unsigned int index = find(key);
+                    bool result = NIL != index;
+                    if(result) {
+                        while(_cardinality == cell(index)->count) {
+                            split(index);
+                            unsigned int first = cell(index)->first;
+                            for(unsigned int i = 0; i < _dimension; ++i) {
+                                if(_regions[first + i].contains(key)) {
+                                    index = first + i;
+                                    break;
+                                }
+                            }
+                        }
+                        Cell* leaf = cell(index);
+                        slots(index)[leaf->count] = element;
+                        ++leaf->count;
+                    }
+                    return result;
+                }
+
+            template <typename K, typename R, typename E>
+                void FlatTree<K, R, E>::remove(E* element) {
+                    unsigned int index = find(element->key());
+                    if(NIL != index) {
+                        Cell* leaf = cell(index);
+                        E** elements = slots(index);
+                        for(unsigned int i = 0; i < leaf->count; ++i) {
+                            if(element == elements[i]) {
+                                --leaf->count;
+                                elements[i] = elements[leaf->count];
+                                break;
+                            }
+                        }
+                        while(NIL != cell(index)->parent) {
+                            index = cell(index)->parent;
+                            unsigned int first = cell(index)->first;
+                            unsigned int global = 0;
+                            for(unsigned int i = 0; i < _dimension; ++i) {
+                                const Cell* target = cell(first + i);
+                                global += target->leaf ? target->count : _cardinality + 1;
+                            }
+                            if(global <= _cardinality) {
+                                merge(index);
+                            } else {
+                                break;
+                            }
+                        }
+                    }
+                }
+
+            template <typename K, typename R, typename E>
+                void FlatTree<K, R, E>::move(E* element, K& key) {
+                    if(find(element->key()) != find(key)) {
+                        remove(element);
+                        element->key(key);
+                        add(element);
+                    } else {
+                        element->key(key);
+                    }
+                }
+
+            template <typename K, typename R, typename E>
+                void FlatTree<K, R, E>::moveAll(E** elements, K* keys, unsigned int count) {
+                    for(unsigned int i = 0; i < count; ++i) {
+                        move(elements[i], keys[i]);
+                    }
+                }
+
+            template <typename K, typename R, typename E>
+                template <typename S, typename V>
+                unsigned int FlatTree<K, R, E>::retrieve(const S& func, E** buffer, unsigned int size,
+                        V* visitor, bool* overflow) const {
+                    Collector<E> collector(buffer, size);
+                    retrieve(0, func, collector, visitor);
+                    if(nullptr != overflow) {
+                        *overflow = collector.overflow();
+                    }
+                    return collector.count();
+                }
+
+            template <typename K, typename R, typename E>
+                template <typename S, typename C, typename V>
+                bool FlatTree<K, R, E>::retrieve(const S& func, C& sink, V* visitor) const {
+                    return retrieve(0, func, sink, visitor);
+                }
+
+            template <typename K, typename R, typename E>
+                template <typename Q, typename C>
+                void FlatTree<K, R, E>::retrieveAll(const Q& queries, unsigned int count,
+                        unsigned int size, C& consumer) const {
+                    #pragma omp parallel
+                    {
+                        E** buffer = new E*[size];
+                        #pragma omp for schedule(dynamic, BATCH_CHUNK_SIZE)
+                        for(unsigned int i = 0; i < count; ++i) {
+                            unsigned int retrieved = retrieve(queries(i), buffer, size);
+                            consumer(i, buffer, retrieved);
+                        }
+                        delete []buffer;
+                    }
+                }
+
+            template <typename K, typename R, typename E>
+                template <typename S, typename C, typename V>
+                bool FlatTree<K, R, E>::retrieve(unsigned int index, const S& func,
+                        C& sink, V* visitor) const {
+                    bool result = true;
+                    if(nullptr != visitor) {
+                        visitor->enter(_regions[index]);
+                    }
+                    const Cell* current = cell(index);
+                    if(current->leaf) {
+                        E** cur = slots(index);
+                        for(unsigned int i = 0; i < current->count && result; ++i, ++cur) {
+                            if(func.contains((*cur)->key())) {
+                                if(nullptr != visitor) {
+                                    visitor->inspect(*cur);
+                                }
+                                result = sink(*cur);
+                            }
+                        }
+                    } else {
+                        unsigned int first = current->first;
+                        for(unsigned int i = 0; i < _dimension && result; ++i) {
+                            int intersects = func.contains(_regions[first + i]);
+                            if(intersects > 0) {
+                                result = fetch(first + i, sink, visitor);
+                            } else if(intersects == 0) {
+                                result = retrieve(first + i, func, sink, visitor);
+                            }
+                        }
+                    }
+                    if(nullptr != visitor) {
+                        visitor->exit(_regions[index]);
+                    }
+                    return result;
+                }
+
+            template <typename K, typename R, typename E>
+                template <typename C, typename V>
+                bool FlatTree<K, R, E>::fetch(unsigned int index, C& sink, V* visitor) const {
+                    bool result = true;
+                    if(nullptr != visitor) {
+                        visitor->enter(_regions[index]);
+                    }
+                    const Cell* current = cell(index);
+                    if(current->leaf) {
+                        E** elements = slots(index);
+                        if(nullptr != visitor) {
+                            visitor->inspect(elements, current->count);
+                        }
+                        for(unsigned int i = 0; i < current->count && result; ++i) {
+                            result = sink(elements[i]);
+                        }
+                    } else {
+                        unsigned int first = current->first;
+                        for(unsigned int i = 0; i < _dimension && result; ++i) {
+                            result = fetch(first + i, sink, visitor);
+                        }
+                    }
+                    if(nullptr != visitor) {
+                        visitor->exit(_regions[index]);
+                    }
+                    return result;
+                }
+
+            template <typename K, typename R, typename E>
+                template <typename V>
+                void FlatTree<K, R, E>::visit(V& visitor) {
+                    visit(0, visitor);
+                }
+
+            template <typename K, typename R, typename E>
+                template <typename V>
+                void FlatTree<K, R, E>::visit(unsigned int index, V& visitor) {
+                    visitor.enter(_regions[index]);
+                    const Cell* current = cell(index);
+                    if(current->leaf) {
+                        visitor.inspect(slots(index), current->count);
+                    } else {
+                        unsigned int first = current->first;
+                        for(unsigned int i = 0; i < _dimension; ++i) {
+                            visit(first + i, visitor);
+                        }
+                    }
+                    visitor.exit(_regions[index]);
+                }
+
+        } // Namespace 'SearchTree'
+    } // Namespace 'Logic'
+} // Namespace 'Headless'
+
+#endif
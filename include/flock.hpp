@@ -16,6 +16,12 @@
 #ifndef HEADLESS_LOGIC_FLOCKING
 #define HEADLESS_LOGIC_FLOCKING
 
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
 // Search Tree are needed to maintain a swarm.
 #include "searchtree.hpp"
 
@@ -24,6 +30,66 @@ namespace Headless {
     namespace Logic {
         namespace Flock {
 
+            /**
+             * Tell if a force accumulates into a provided velocity, i.e. if it implements
+             * 'void compute(double, E*, E**, unsigned int, V&)'.
+             * @param <F> Force concept.
+             * @param <E> Agent concept.
+             * @param <V> Velocity type.
+             */
+            template <typename F, typename E, typename V> class Accumulating {
+                private:
+                    template <typename T> static char test(
+                            decltype(std::declval<T&>().compute(std::declval<double>(),
+                                    std::declval<E*>(), std::declval<E**>(),
+                                    std::declval<unsigned int>(), std::declval<V&>()))*);
+                    template <typename T> static long test(...);
+                public:
+                    static const bool value = sizeof(test<F>(nullptr)) == sizeof(char);
+            };
+
+            /**
+             * Tell if a force is weighted, i.e. if it implements 'weight() const',
+             * returning a scalar its velocity can be multiplied by.
+             * @param <F> Force concept.
+             */
+            template <typename F> class Weighted {
+                private:
+                    template <typename T> static char test(
+                            decltype(std::declval<const T&>().weight())*);
+                    template <typename T> static long test(...);
+                public:
+                    static const bool value = sizeof(test<F>(nullptr)) == sizeof(char);
+            };
+
+            /**
+             * Tell if a force declares the perception radius it needs, i.e. if it
+             * implements 'double radius() const'.
+             * @param <F> Force concept.
+             */
+            template <typename F> class Ranged {
+                private:
+                    template <typename T> static char test(
+                            decltype(std::declval<const T&>().radius())*);
+                    template <typename T> static long test(...);
+                public:
+                    static const bool value = sizeof(test<F>(nullptr)) == sizeof(char);
+            };
+
+            /**
+             * Tell if a perception tool can be resized, i.e. if it implements
+             * 'void radius(double)'.
+             * @param <P> Perception tool concept.
+             */
+            template <typename P> class Resizable {
+                private:
+                    template <typename T> static char test(
+                            decltype(std::declval<T&>().radius(std::declval<double>()))*);
+                    template <typename T> static long test(...);
+                public:
+                    static const bool value = sizeof(test<P>(nullptr)) == sizeof(char);
+            };
+
             /**
              * Swarm. A set of agent interacting together in order to simulate a crowd.
              * @param <K> Agent Key concept. See Search Tree Node.
@@ -42,13 +108,21 @@ namespace Headless {
              * @param <P> Perception tool concept. This concept must implement the following methods:
              *              int contains(const R&); <- Partially or fully contains a region.
              *              bool contains(const K&); <- Contains a key.
+             * @param <T> Search tree type. Either 'SearchTree::Node' or any tree exposing
+             *              the same interface, e.g. 'SearchTree::FlatTree',
+             *              'SearchTree::MortonTree' or 'SearchTree::Grid'.
              */
-            template <typename K, class R, class E, class G, class P> class Swarm {
+            template <typename K, class R, class E, class G, class P,
+                     class T = SearchTree::Node<K, R, E> > class Swarm {
                 private:
+                    /**
+                     * Managed region.
+                     */
+                    R _region;
                     /**
                      * Search tree.
                      */
-                    SearchTree::Node<K, R, E> *_tree;
+                    T *_tree;
                     /**
                      * Swarm Pool.
                      */
@@ -69,17 +143,63 @@ namespace Headless {
                      * Buffer for perception tool.
                      */
                     E** _perceived;
+                    /**
+                     * Run the force computation phase on several threads.
+                     */
+                    bool _parallel;
+                    /**
+                     * Double-buffered agent states.
+                     */
+                    bool _buffered;
+                    /**
+                     * Next agent states (raw storage), when buffered.
+                     */
+                    E* _next;
+                    /**
+                     * Neighbour lists margin, negative when lists are not cached.
+                     */
+                    double _skin;
+                    /**
+                     * Key metric, for agent displacements.
+                     */
+                    std::function<double(const K&, const K&)> _metric;
+                    /**
+                     * Cached neighbour list of each agent.
+                     */
+                    std::vector<E*>* _lists;
+                    /**
+                     * Agent keys at the time of their last query.
+                     */
+                    K* _anchors;
+                    /**
+                     * Tell if the neighbour lists are valid.
+                     */
+                    bool _valid;
                 public:
                     /**
                      * Constructor.
                      * @param region Managed region.
                      * @param capacity Maximum number of agent.
+                     * @param parallel Compute forces on several threads (requires OpenMP).
+                     * In that case, the adaptor and forces 'compute' methods are called
+                     * concurrently and must be thread-safe.
+                     * @param buffered Double-buffer agent states: forces perceive the
+                     * agents as they were at the beginning of the update, while the adaptor
+                     * works on copies which are committed once all forces are computed.
+                     * Agents must then be copyable. Results do not depend on the
+                     * evaluation order, so that serial and parallel updates are identical.
                      */
-                    Swarm(R region, unsigned int capacity) : _cardinality(0), _capacity(capacity) {
-                        _tree = new SearchTree::Node<K, R, E>(region);
+                    Swarm(R region, unsigned int capacity, bool parallel = false, bool buffered = false) :
+                        _region(region), _cardinality(0), _capacity(capacity), _parallel(parallel),
+                        _buffered(buffered), _next(nullptr), _skin(-1.0),
+                        _lists(nullptr), _anchors(nullptr), _valid(false) {
+                        _tree = new T(&_region);
                         _perceived = new E*[capacity];
                         _swarm = new E*[capacity];
                         _keys = new K[capacity];
+                        if(buffered) {
+                            _next = static_cast<E*>(::operator new(capacity * sizeof(E)));
+                        }
                     }
 
                     /**
@@ -90,6 +210,45 @@ namespace Headless {
                         delete []_swarm;
                         delete []_perceived;
                         delete []_keys;
+                        ::operator delete(_next);
+                        delete []_lists;
+                        delete []_anchors;
+                    }
+
+                    /**
+                     * Cache neighbour lists, Verlet style. Agents query with their
+                     * perception radius (the forces reach when they all declare one)
+                     * extended by a skin, and all lists are kept until the two largest
+                     * agent displacements since the queries add up to more than the skin,
+                     * or until the cache is invalidated. No pair of agents can then have
+                     * come closer than the skin, so lists hold every neighbour within
+                     * the radius. Forces receive neighbours up to the extended radius
+                     * and must check distances themselves.
+                     * The perception tool must expose and accept its radius:
+                     *   double radius() const;
+                     *   void radius(double);
+                     * @param <D> Metric concept, implementing
+                     * 'double distance(const K&, const K&) const'.
+                     * @param skin Margin added to the perception radius.
+                     * @param metric Key metric.
+                     */
+                    template <typename D> void cache(double skin, const D& metric) {
+                        static_assert(Resizable<P>::value && Ranged<P>::value,
+                                "Cached neighbour lists need a perception radius to extend.");
+                        if(nullptr == _lists) {
+                            _lists = new std::vector<E*>[_capacity];
+                            _anchors = new K[_capacity];
+                        }
+                        _skin = skin;
+                        _metric = [metric](const K& a, const K& b) { return metric.distance(a, b); };
+                        invalidate();
+                    }
+
+                    /**
+                     * Force every neighbour list to be rebuilt on the next update.
+                     */
+                    void invalidate() {
+                        _valid = false;
                     }
 
                     /**
@@ -97,54 +256,282 @@ namespace Headless {
                      * @param element Agent to add.
                      * @return true if succeeded in adding the agent.
                      */
-                    bool add(E *element);
+                    bool add(E *element) {
+                        bool result = _cardinality < _capacity && _tree->add(element);
+                        if(result) {
+                            _swarm[_cardinality] = element;
+                            ++_cardinality;
+                            invalidate();
+                        }
+                        return result;
+                    }
 
                     /**
                      * Remove an agent.
                      * @param element Agent to remove.
                      */
-                    void remove(E *element);
+                    void remove(E *element) {
+                        for(unsigned int i = 0; i < _cardinality; ++i) {
+                            if(element == _swarm[i]) {
+                                _tree->remove(element);
+                                --_cardinality;
+                                _swarm[i] = _swarm[_cardinality];
+                                // Lists may refer to the removed agent.
+                                invalidate();
+                                break;
+                            }
+                        }
+                    }
 
                     /**
                      * Move an agent.
                      * @param element Agent to move.
                      * @param target New agent key.
                      */
-                    void move(E *element, K& target);
+                    void move(E *element, K& target) {
+                        _tree->move(element, target);
+                    }
+
+                    /**
+                     * Run a symmetric interaction once per pair of nearby agents, e.g. to
+                     * accumulate separation onto both agents of a pair in a single pass.
+                     * Requires a tree implementing 'pairs', see 'SearchTree::Node::pairs'.
+                     * @param proximity Tell if agents of two regions may interact.
+                     * @param kernel Interaction between two blocks of agents.
+                     */
+                    template <class N, class C> void pairs(const N& proximity, C& kernel) const {
+                        _tree->pairs(proximity, kernel);
+                    }
 
-                    // TODO
+                    /**
+                     * Update the swarm.
+                     * Each agent perceives its neighbours, forces are combined into a velocity
+                     * from which the adaptor computes the new agent key. Agents are then moved.
+                     * When all forces declare a radius and the perception tool can be resized,
+                     * agents perceive up to the largest force radius only.
+                     * @param <V> Velocity type, sum of the forces.
+                     * @param <A> Adaptor concept. Must implement:
+                     *              K compute(const V&, E*, float, unsigned int);
+                     *            and may update the agent it is given (see 'buffered').
+                     * @param <F> Force concepts. Must implement either:
+                     *              V compute(double, E*, E**, unsigned int);
+                     *            whose result is added, after multiplication by 'weight()'
+                     *            if the force implements it, or:
+                     *              void compute(double, E*, E**, unsigned int, V&);
+                     *            which adds its own contribution. Forces may also implement:
+                     *              double radius() const;
+                     * @param elapsed Elapsed time.
+                     * @param origin Velocity forces are added to.
+                     * @param adaptor Key adaptor.
+                     * @param forces Forces applied to each agent, in that order.
+                     */
                     template<typename V, class A, class ... F>
-                        void update(float elapsed, A& adaptor, F& ... forces) {
+                        void update(float elapsed, const V& origin, A& adaptor, F& ... forces) {
+                            // Snapshot of the next states, adaptors write there.
+                            if(_buffered) {
+                                for(unsigned int i = 0; i < _cardinality; ++i) {
+                                    new (_next + i) E(*_swarm[i]);
+                                }
+                            }
+                            double reach = range(forces...);
                             // Compute forces.
-                            for(unsigned int i = 0; i < _cardinality; ++i) {
-                                const P& tool = _swarm[i]->detector();
-                                const G& goal = _swarm[i]->goal();
-                                unsigned int count = _tree->retrieve(tool, _perceived, _capacity);
-                                V velocity = apply(elapsed, _swarm[i], _perceived, count, forces...);
-                                _keys[i] = adaptor.compute(velocity, _swarm[i], elapsed, count);
+                            if(_skin >= 0.0) {
+                                bool rebuild = stale();
+                                #pragma omp parallel for schedule(dynamic, BATCH_CHUNK_SIZE) if(_parallel)
+                                for(unsigned int i = 0; i < _cardinality; ++i) {
+                                    if(rebuild) {
+                                        neighbours(i, reach);
+                                    }
+                                    unsigned int count = static_cast<unsigned int>(_lists[i].size());
+                                    V velocity(origin);
+                                    apply(velocity, elapsed, _swarm[i], _lists[i].data(), count, forces...);
+                                    _keys[i] = adaptor.compute(velocity, target(i), elapsed, count);
+                                }
+                            } else if(_parallel) {
+                                // Perception is read-only on the tree, each agent only
+                                // writes its own key.
+                                auto queries = [this, reach](unsigned int i) -> P {
+                                    return perception(i, reach);
+                                };
+                                auto consumer = [&](unsigned int i, E** perceived, unsigned int count) {
+                                    V velocity(origin);
+                                    apply(velocity, elapsed, _swarm[i], perceived, count, forces...);
+                                    _keys[i] = adaptor.compute(velocity, target(i), elapsed, count);
+                                };
+                                _tree->retrieveAll(queries, _cardinality, _capacity, consumer);
+                            } else {
+                                for(unsigned int i = 0; i < _cardinality; ++i) {
+                                    P tool = perception(i, reach);
+                                    unsigned int count = _tree->retrieve(tool, _perceived, _capacity);
+                                    V velocity(origin);
+                                    apply(velocity, elapsed, _swarm[i], _perceived, count, forces...);
+                                    _keys[i] = adaptor.compute(velocity, target(i), elapsed, count);
+                                }
+                            }
+                            // Commit the next states, in agent order. Keys are left to the tree.
+                            if(_buffered) {
+                                for(unsigned int i = 0; i < _cardinality; ++i) {
+                                    K key = _swarm[i]->key();
+                                    *_swarm[i] = _next[i];
+                                    _swarm[i]->key(key);
+                                    _next[i].~E();
+                                }
                             }
                             // Move agents
-                            for(unsigned int i = 0; i < _cardinality; ++i) {
-                                _tree->move(_swarm[i], _keys[i]);
+                            _tree->moveAll(_swarm, _keys, _cardinality);
+                        }
+
+                    /**
+                     * Update the swarm, forces being added to a value initialized velocity.
+                     * Disabled for a velocity first argument, so that a mutable origin
+                     * still selects the overload above.
+                     * @param elapsed Elapsed time.
+                     * @param adaptor Key adaptor.
+                     * @param forces Forces applied to each agent, in that order.
+                     */
+                    template<typename V, class A, class ... F>
+                        typename std::enable_if<!std::is_same<typename std::decay<A>::type, V>::value>::type
+                        update(float elapsed, A& adaptor, F& ... forces) {
+                            update(elapsed, V(), adaptor, forces...);
+                        }
+
+                private:
+                    /**
+                     * Agent given to the adaptor.
+                     * @param index Agent index.
+                     * @return The agent itself, or its next state when buffered.
+                     */
+                    E* target(unsigned int index) {
+                        return _buffered ? _next + index : _swarm[index];
+                    }
+
+                    /**
+                     * Tell if the neighbour lists must be rebuilt, and mark them valid
+                     * if so: the lists are invalid or two agents may have moved closer
+                     * than the skin since the queries.
+                     * @return true if the lists must be rebuilt.
+                     */
+                    bool stale() {
+                        double first = 0.0;
+                        double second = 0.0;
+                        for(unsigned int i = 0; _valid && i < _cardinality; ++i) {
+                            double displacement = _metric(_swarm[i]->key(), _anchors[i]);
+                            if(displacement > first) {
+                                second = first;
+                                first = displacement;
+                            } else if(displacement > second) {
+                                second = displacement;
                             }
                         }
+                        bool result = !_valid || first + second > _skin;
+                        _valid = true;
+                        return result;
+                    }
 
-                   private:
+                    /**
+                     * Rebuild the cached neighbour list of an agent.
+                     * @param index Agent index.
+                     * @param reach Forces reach, negative if unknown.
+                     */
+                    void neighbours(unsigned int index, double reach) {
+                        std::vector<E*>& list = _lists[index];
+                        list.clear();
+                        P tool = perception(index, reach);
+                        widen(tool, _skin, std::integral_constant<bool,
+                                Resizable<P>::value && Ranged<P>::value>());
+                        auto collect = [&list](E* element) {
+                            list.push_back(element);
+                            return true;
+                        };
+                        _tree->retrieve(tool, collect);
+                        _anchors[index] = _swarm[index]->key();
+                    }
 
-                    // TODO
-                    template<typename V, class F, class ... O>
-                        V& apply(double elapsed, E* subject, E** perceived, unsigned int count, F& force, O& ... others) {
-                             V result = force.compute(elapsed, subject, perceived, count);
-                             result += apply(elapsed, subject, perceived, count, others...);
-                             return result;
+                    /**
+                     * Perception tool of an agent, narrowed to the forces reach.
+                     * @param index Agent index.
+                     * @param reach Largest force radius, negative if unknown.
+                     * @return Perception tool.
+                     */
+                    P perception(unsigned int index, double reach) const {
+                        P tool = _swarm[index]->detector();
+                        narrow(tool, reach, std::integral_constant<bool, Resizable<P>::value>());
+                        return tool;
+                    }
+                    static void narrow(P& tool, double reach, std::true_type) {
+                        if(reach >= 0.0) {
+                            tool.radius(reach);
                         }
+                    }
+                    static void narrow(P&, double, std::false_type) {}
+                    static void widen(P& tool, double skin, std::true_type) {
+                        tool.radius(tool.radius() + skin);
+                    }
+                    static void widen(P&, double, std::false_type) {}
 
-                    // TODO
-                    template<typename V, class F>
-                        V& apply(double elapsed, E* subject, E** perceived, unsigned int count, F& force) {
-                            return force.compute(elapsed, subject, perceived, count);
+                    /**
+                     * Largest radius declared by the forces.
+                     * @param forces Forces.
+                     * @return The radius, negative if a force does not declare one or
+                     * if there is no force, agents then keeping their own radius.
+                     */
+                    template<class ... F> static double range(F& ... forces) {
+                        if(sizeof...(F) == 0) {
+                            return -1.0;
                         }
+                        double result = 0.0;
+                        double radii[] = { 0.0, radius(forces,
+                                std::integral_constant<bool, Ranged<F>::value>())... };
+                        for(double value : radii) {
+                            if(value < 0.0) {
+                                result = -1.0;
+                                break;
+                            }
+                            result = value > result ? value : result;
+                        }
+                        return result;
+                    }
+                    template<class F> static double radius(F& force, std::true_type) {
+                        return force.radius();
+                    }
+                    template<class F> static double radius(F&, std::false_type) {
+                        return -1.0;
+                    }
 
+                    /**
+                     * Add the forces applied to an agent to its velocity, in order.
+                     * @param velocity Velocity to accumulate into.
+                     * @param elapsed Elapsed time.
+                     * @param subject Agent.
+                     * @param perceived Perceived agents.
+                     * @param count Number of perceived agents.
+                     * @param forces Forces.
+                     */
+                    template<typename V, class ... F>
+                        static void apply(V& velocity, double elapsed, E* subject, E** perceived,
+                                unsigned int count, F& ... forces) {
+                            // Braced initializers are evaluated in order.
+                            int expansion[] = { 0, (accumulate(velocity, elapsed, subject, perceived,
+                                        count, forces, std::integral_constant<bool,
+                                        Accumulating<F, E, V>::value>(),
+                                        std::integral_constant<bool, Weighted<F>::value>()), 0)... };
+                            (void) expansion;
+                        }
+                    template<typename V, class F, typename W>
+                        static void accumulate(V& velocity, double elapsed, E* subject, E** perceived,
+                                unsigned int count, F& force, std::true_type, W) {
+                            force.compute(elapsed, subject, perceived, count, velocity);
+                        }
+                    template<typename V, class F>
+                        static void accumulate(V& velocity, double elapsed, E* subject, E** perceived,
+                                unsigned int count, F& force, std::false_type, std::true_type) {
+                            velocity += force.compute(elapsed, subject, perceived, count) * force.weight();
+                        }
+                    template<typename V, class F>
+                        static void accumulate(V& velocity, double elapsed, E* subject, E** perceived,
+                                unsigned int count, F& force, std::false_type, std::false_type) {
+                            velocity += force.compute(elapsed, subject, perceived, count);
+                        }
             };
 
         } // Namespace 'Flock'
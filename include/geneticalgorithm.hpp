@@ -16,8 +16,31 @@
 #ifndef HEADLESS_LOGIC_GENETIC_ALGORITHM
 #define HEADLESS_LOGIC_GENETIC_ALGORITHM
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <new>
 #include <random>
+#include <thread>
 #include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * Alignment of the candidate arena, in bytes.
+ */
+#define GA_ARENA_ALIGNMENT 64
 
 namespace Headless {
     namespace Logic {
@@ -25,9 +48,30 @@ namespace Headless {
          * Here are proposed some implementations of General Algorithms.
          * Currently available GAs are:
          *  - Trivial.
+         *  - Islands, running several Trivial populations exchanging migrants.
+         *  - SteadyState, replacing the worst candidate as each evaluation ends.
+         * Any of them can use a 'Cached' environment to skip evaluating candidates
+         * already seen.
          */
         namespace GA {
 
+            /**
+             * Tell if an environment can evaluate a batch of candidates at once, i.e. if
+             * it implements 'void evaluate(const C** candidates, unsigned int count, double* scores)',
+             * setting 'scores[i]' to the error of 'candidates[i]'.
+             * @param <E> Environment concept.
+             * @param <C> Candidate concept.
+             */
+            template <typename E, typename C> class Batched {
+                private:
+                    template <typename T> static char test(
+                            decltype(std::declval<T&>().evaluate(std::declval<const C**>(),
+                                    0u, std::declval<double*>()))*);
+                    template <typename T> static long test(...);
+                public:
+                    static const bool value = sizeof(test<E>(nullptr)) == sizeof(char);
+            };
+
             /**
              * Trivial GA.
              * 1. Generate first pool.
@@ -37,20 +81,44 @@ namespace Headless {
              * 5. Back to step 2 until error is superior to specified
              *    or until generation number is inferior to specified.
              *
+             * Randomness comes from per-thread streams owned by the engine and
+             * handed to the mutators. Streams are derived from a single seed:
+             * with a deterministic environment and the same number of threads,
+             * a run can be reproduced from its seed.
+             *
+             * In arena mode, the engine stores candidates itself, by value, in
+             * one aligned block holding two generations. Offspring are written
+             * in place into the next generation while the elite of the current
+             * one is read, and evaluation walks candidates linearly in memory.
+             *
              * To this purpose, we need the following concepts :
              * @param <C> Candidates to be evaluated and modified.
+             * @param <G> Random number engine. Defaults to 'std::mt19937'.
              */
-            template <typename C> class Trivial {
+            template <typename C, typename G = std::mt19937> class Trivial {
+                public:
+                    /**
+                     * Random number engine type.
+                     */
+                    typedef G Generator;
+
                 public:
 
                     /**
                      * Constructor.
                      * @param pSize Pool Size.
+                     * @param seed Seed of the random streams. Defaults to a
+                     *      non-deterministic one.
+                     * @param arena Arena mode flag, candidates must then be copy
+                     *      constructible and assignable.
                      */
-                    Trivial(unsigned int pSize) : _count(pSize) {
+                    Trivial(unsigned int pSize, unsigned long seed = std::random_device()(),
+                            bool arena = false) : _count(pSize), _arena(arena),
+                            _memory(nullptr), _buffer(nullptr), _current(nullptr), _parallel(true) {
                         _pool = new C*[pSize];
                         _score = new double[pSize];
                         _reverse = new double[pSize];
+                        this->seed(seed);
                     }
 
                     /**
@@ -60,6 +128,24 @@ namespace Headless {
                         delete []_pool;
                         delete []_score;
                         delete []_reverse;
+                        ::operator delete(_memory);
+                    }
+
+                    /**
+                     * Reset the random streams.
+                     * @param seed Seed from which each thread stream is derived.
+                     */
+                    void seed(unsigned long seed) {
+                        _seed = seed;
+                        _streams.clear();
+                        streams();
+                    }
+
+                    /**
+                     * @return Seed of the current random streams.
+                     */
+                    unsigned long seed() const {
+                        return _seed;
                     }
 
                     /**
@@ -70,11 +156,23 @@ namespace Headless {
                      *      - void release(C**, unsigned int)
                      *      - double evaluate (const C*)
                      *      - C* clone(const C*)
+                     *      When it also defines 'void evaluate(const C**, unsigned int, double*)',
+                     *      the whole pool is handed over to it at once. See 'Batched'.
+                     *      In arena mode, reserved candidates are copied into the
+                     *      arena and released right away.
                      * @param <V> Visitor.
                      * @param <... M> Set of operators/mutators types. A mutator must define
                      *      the following methods:
                      *      - double threshold()
-                     *      - void mutate(C**, unsigned int, C*);
+                     *      - void mutate(C** elite, double* reversedScores, double total,
+                     *          unsigned int count, C* offspring, G& generator);
+                     *      The elite is sorted, best first, and 'reversedScores[i]'
+                     *      weighs 'elite[i]': scores are reversed so that the best
+                     *      candidates weigh most, 'total' being their sum. Only the
+                     *      first 'count' entries of both arrays may be read: the
+                     *      following candidates are offspring, written concurrently.
+                     *      The generator is the stream of the calling thread and
+                     *      is the only source of randomness a mutator should use.
                      * @param env Environment.
                      * @param visitor Visitor. Can't be null.
                      * @param maxGen Maximum number of generations.
@@ -91,32 +189,25 @@ namespace Headless {
                             C** store, unsigned int size,
                             M... mutators) {
                         unsigned int eliteCount = _count * eliteSize;
+                        // The thread count may have changed since seeding.
+                        streams();
                         // We assume that the pool is empty and needs to be filled.
                         env->reserve(_pool, _count);
+                        if(_arena) {
+                            adopt(env);
+                        }
 
                         // Loop on generations.
                         double minimum;
                         unsigned int generation;
                         for(generation = 0;
-                                (generation < maxGen) && ((minimum = evaluate(env)) > minErr);
+                                (generation < maxGen) && ((minimum = evaluate(env, eliteCount)) > minErr);
                                 ++generation) {
-                            // At this point, the pool is full and sorted.
-                            // Let's create a reverse score board.
-                            double totalScore = 0;
-                            for(unsigned int i = 0; i < eliteCount; ++i) {
-                                _reverse[eliteCount - i] = _score[i];
-                                totalScore += _score[i];
-                            }
                             // Visit the elite.
                             if(visitor != nullptr) {
                                 visitor->visit(_pool, eliteCount);
                             }
-                            // Let's recycle candidates from eliteCount to _count - 1.
-                            #pragma omp parallel for
-                            for(unsigned int i = eliteCount; i < _count; ++i) {
-                                // Randomly choose a mutators.
-                                mutate(totalScore, i, eliteCount, mutators...);
-                            }
+                            breed(eliteCount, mutators...);
                         }
 
                         unsigned int number = eliteCount < size ? eliteCount : size;
@@ -125,50 +216,186 @@ namespace Headless {
                         }
 
                         // Clean-up the pool.
-                        env->release(_pool, _count);
+                        if(_arena) {
+                            for(unsigned int i = 0; i < 2 * _count; ++i) {
+                                _buffer[i].~C();
+                            }
+                        } else {
+                            env->release(_pool, _count);
+                        }
 
                         return std::make_tuple(generation, minimum, number);
                     }
 
                 private:
+                    template <typename, typename, typename> friend class Islands;
+
+                    /**
+                     * Replace the candidates following the elite with offspring.
+                     * @param <... M> Mutators types.
+                     * @param eliteCount Elite size, the pool elite being sorted.
+                     * @param mutators Set of operators/mutators.
+                     */
+                    template <typename... M> void breed(unsigned int eliteCount, M... mutators) {
+                        // Let's create a reverse score board.
+                        double totalScore = 0;
+                        for(unsigned int i = 0; i < eliteCount; ++i) {
+                            _reverse[eliteCount - 1 - i] = _score[i];
+                            totalScore += _score[i];
+                        }
+                        // Let's recycle candidates from eliteCount to _count - 1.
+                        // Static scheduling keeps the offspring-to-stream mapping
+                        // reproducible.
+                        C* next = nullptr;
+                        if(_arena) {
+                            // Carry the elite over, offspring are written
+                            // after it.
+                            next = (_current == _buffer) ? _buffer + _count : _buffer;
+                            for(unsigned int i = 0; i < eliteCount; ++i) {
+                                next[i] = *_pool[i];
+                            }
+                        }
+                        #pragma omp parallel for schedule(static) if(_parallel)
+                        for(unsigned int i = eliteCount; i < _count; ++i) {
+                            G& generator = _streams[thread()];
+                            // Randomly choose a mutators.
+                            mutate(generator, totalScore, _arena ? next + i : _pool[i],
+                                    eliteCount, mutators...);
+                        }
+                        if(_arena) {
+                            _current = next;
+                            for(unsigned int i = 0; i < _count; ++i) {
+                                _pool[i] = next + i;
+                            }
+                        }
+                    }
+
                     /**
                      * make a new offspring out of the available mutators.
                      */
-                    template <typename M, typename... O> void mutate(double total, unsigned int pos, unsigned int count,
-                            M mutator, O... others) {
-                        std::random_device rd;
-                        std::mt19937 mt(rd());
+                    template <typename M, typename... O> void mutate(G& generator, double total,
+                            C* offspring, unsigned int count, M mutator, O... others) {
                         std::uniform_real_distribution<double> dist(0.0, 1.0);
-                        double rnd = dist(mt);
+                        double rnd = dist(generator);
                         if(rnd < mutator->threshold()) {
-                            mutator->mutate(_pool, _reverse, total, count, _pool[pos]);
+                            mutator->mutate(_pool, _reverse, total, count, offspring, generator);
                         } else {
-                            mutate(total, pos, count, others...);
+                            mutate(generator, total, offspring, count, others...);
+                        }
+                    }
+
+                    template <typename M> void mutate(G& generator, double total,
+                            C* offspring, unsigned int count, M mutator) {
+                        mutator->mutate(_pool, _reverse, total, count, offspring, generator);
+                    }
+
+                    /**
+                     * Move the reserved candidates into the arena, allocated on
+                     * first use. Both generations start as copies of the reserved
+                     * candidates.
+                     * @param <E> Environment type.
+                     * @param env Environment.
+                     */
+                    template <typename E> void adopt(E* env) {
+                        if(_memory == nullptr) {
+                            _memory = ::operator new(2 * _count * sizeof(C) + GA_ARENA_ALIGNMENT);
+                            std::uintptr_t address = reinterpret_cast<std::uintptr_t>(_memory);
+                            address = (address + GA_ARENA_ALIGNMENT - 1)
+                                & ~static_cast<std::uintptr_t>(GA_ARENA_ALIGNMENT - 1);
+                            _buffer = reinterpret_cast<C*>(address);
+                        }
+                        for(unsigned int i = 0; i < _count; ++i) {
+                            new (_buffer + i) C(*_pool[i]);
+                            new (_buffer + _count + i) C(*_pool[i]);
+                        }
+                        env->release(_pool, _count);
+                        _current = _buffer;
+                        for(unsigned int i = 0; i < _count; ++i) {
+                            _pool[i] = _buffer + i;
+                        }
+                    }
+
+                    /**
+                     * Make sure there is one stream per available thread. Stream
+                     * 'i' only depends on the seed and on 'i'.
+                     */
+                    void streams() {
+                        unsigned int count = 1;
+#ifdef _OPENMP
+                        count = static_cast<unsigned int>(omp_get_max_threads());
+#endif
+                        for(unsigned int i = static_cast<unsigned int>(_streams.size()); i < count; ++i) {
+                            std::seed_seq sequence{static_cast<unsigned int>(_seed),
+                                static_cast<unsigned int>(_seed >> 16 >> 16), i};
+                            _streams.push_back(G(sequence));
                         }
                     }
 
-                    template <typename M> void mutate(double total, unsigned int pos, unsigned int count, M mutator) {
-                        mutator->mutate(_pool, _reverse, total, count, _pool[pos]);
+                    /**
+                     * @return Index of the calling thread stream.
+                     */
+                    static unsigned int thread() {
+#ifdef _OPENMP
+                        return static_cast<unsigned int>(omp_get_thread_num());
+#else
+                        return 0;
+#endif
                     }
 
                     /**
                      * Evaluate the pool against the environment.
                      * @param <E> Environment type.
                      * @param env Environment.
-                     * @return Minimal error. At return time, the pool is sorted
-                     * using candidates scores.
+                     * @param count Number of best candidates to rank.
+                     * @return Minimal error. At return time, the 'count' best
+                     * candidates lead the pool, sorted using their scores. The
+                     * remaining candidates are in no particular order.
                      */
-                    template <typename E> double evaluate(E* env) {
+                    template <typename E> double evaluate(E* env, unsigned int count) {
                         // Evaluate ...
-                        #pragma omp parallel for
+                        evaluate(env, std::integral_constant<bool, Batched<E, C>::value>());
+
+                        // ... select the elite and only sort it.
+                        count = count < 1 ? 1 : (count > _count ? _count : count);
+                        select(0, _count - 1, count - 1);
+                        qsort(0, count - 1);
+
+                        return _score[0];
+                    }
+
+                    /**
+                     * Evaluate the pool, candidate by candidate.
+                     */
+                    template <typename E> void evaluate(E* env, std::false_type) {
+                        #pragma omp parallel for if(_parallel)
                         for(unsigned int i = 0; i < _count; ++i) {
                             _score[i] = env->evaluate(_pool[i]);
                         }
+                    }
 
-                        // ... and sort.
-                        qsort(0, _count - 1);
+                    /**
+                     * Evaluate the pool in one batch.
+                     */
+                    template <typename E> void evaluate(E* env, std::true_type) {
+                        env->evaluate(const_cast<const C**>(_pool), _count, _score);
+                    }
 
-                        return _score[0];
+                    /**
+                     * Quick select: partition the pool so that the 'k'-th smallest
+                     * score sits at 'k', with smaller or equal scores before it.
+                     * @param lo Lower bound.
+                     * @param hi Higher bound.
+                     * @param k Rank to select, between 'lo' and 'hi'.
+                     */
+                    void select(unsigned int lo, unsigned int hi, unsigned int k) {
+                        while(lo < hi) {
+                            unsigned int pivot = partition(lo, hi);
+                            if(k <= pivot) {
+                                hi = pivot;
+                            } else {
+                                lo = pivot + 1;
+                            }
+                        }
                     }
 
                     /**
@@ -177,34 +404,43 @@ namespace Headless {
                      * @param hi Higher bound.
                      */
                     void qsort(unsigned int lo, unsigned int hi) {
-                        if(lo < hi) {
+                        while(lo < hi) {
                             // We don't make fat partitionning as we are manipulating
                             // fine-grained over-distributed scores. We should not
                             // have arrays of identical scores.
+                            // Recurse on the smaller side only to bound the stack.
                             unsigned int pivot = partition(lo, hi);
-                            if((pivot - lo) < (hi - (pivot + 1))) {
+                            if((pivot - lo) < (hi - pivot)) {
                                 qsort(lo, pivot);
-                                qsort(pivot + 1, hi);
+                                lo = pivot + 1;
                             } else {
                                 qsort(pivot + 1, hi);
-                                qsort(lo, pivot);
+                                hi = pivot;
                             }
-
                         }
                     }
 
+                    /**
+                     * Hoare partition around the middle score.
+                     * @param lo Lower bound.
+                     * @param hi Higher bound, strictly greater than 'lo'.
+                     * @return Position 'p', with 'lo <= p < hi', such that scores in
+                     * [lo, p] are lower or equal to the ones in [p + 1, hi].
+                     */
                     unsigned int partition(unsigned int lo, unsigned int hi) {
-                        double pivot = _score[lo];
-                        unsigned int i = lo - 1;
-                        unsigned int j = hi + 1;
+                        // The elite of the previous generation leads the pool already
+                        // sorted: a middle pivot avoids degenerated partitions.
+                        double pivot = _score[lo + (hi - lo) / 2];
+                        unsigned int i = lo;
+                        unsigned int j = hi;
 
                         for(;;) {
-                            do {
+                            while(_score[i] < pivot) {
                                 ++i;
-                            } while(_score[i] < pivot);
-                            do {
+                            }
+                            while(_score[j] > pivot) {
                                 --j;
-                            } while(_score[j] > pivot);
+                            }
                             if(i >= j) {
                                 return j;
                             }
@@ -214,8 +450,10 @@ namespace Headless {
                             _pool[i] = _pool[j];
                             _score[j] = score;
                             _pool[j] = candidate;
+                            // After a swap, 'lo <= i < j <= hi': neither can wrap.
+                            ++i;
+                            --j;
                         }
-                        return 0; // Should never happen.
                     }
 
                 private:
@@ -239,6 +477,817 @@ namespace Headless {
                      * Pool count.
                      */
                     unsigned int _count;
+
+                    /**
+                     * Seed of the random streams.
+                     */
+                    unsigned long _seed;
+
+                    /**
+                     * Per-thread random streams.
+                     */
+                    std::vector<G> _streams;
+
+                    /**
+                     * Arena mode flag.
+                     */
+                    bool _arena;
+
+                    /**
+                     * Arena raw memory.
+                     */
+                    void *_memory;
+
+                    /**
+                     * Arena, aligned, holding two generations.
+                     */
+                    C *_buffer;
+
+                    /**
+                     * Current generation in the arena.
+                     */
+                    C *_current;
+
+                    /**
+                     * OpenMP flag, cleared for engines run by a worker thread.
+                     */
+                    bool _parallel;
+            };
+
+            /**
+             * Ring migration topology: island 'i' sends its migrants to island 'i + 1'.
+             */
+            class Ring {
+                public:
+                    /**
+                     * @param <G> Random number engine type.
+                     * @param source Emitting island.
+                     * @param count Number of islands, at least two.
+                     * @param generator Random stream of the emitting island.
+                     * @return Receiving island.
+                     */
+                    template <typename G> unsigned int target(unsigned int source,
+                            unsigned int count, G& /* generator */) const {
+                        return (source + 1) % count;
+                    }
+            };
+
+            /**
+             * Scattered migration topology: migrants go to any other island,
+             * drawn uniformly on each migration.
+             */
+            class Scattered {
+                public:
+                    /**
+                     * @param <G> Random number engine type.
+                     * @param source Emitting island.
+                     * @param count Number of islands, at least two.
+                     * @param generator Random stream of the emitting island.
+                     * @return Receiving island.
+                     */
+                    template <typename G> unsigned int target(unsigned int source,
+                            unsigned int count, G& generator) const {
+                        std::uniform_int_distribution<unsigned int> dist(0, count - 2);
+                        unsigned int target = dist(generator);
+                        return target < source ? target : target + 1;
+                    }
+            };
+
+            /**
+             * Island model GA.
+             * Several 'Trivial' populations, the islands, evolve independently,
+             * each on its own worker thread. Every 'interval' generations, an
+             * island sends copies of its best candidates to another island,
+             * chosen by the topology. Migrants are posted to the receiver
+             * mailbox: islands never wait for each other, and received migrants
+             * replace offspring of the receiver next generation.
+             *
+             * Islands only synchronize on the environment 'reserve', 'release'
+             * and 'clone' methods and on the visitor, which are serialized.
+             * Evaluation is called concurrently, as with 'Trivial'. Training
+             * stops as soon as one island reaches the minimal error. As islands
+             * run at their own pace, runs are not reproducible from the seed.
+             * @param <C> Candidates. See 'Trivial'.
+             * @param <T> Migration topology. It must define:
+             *      - template <typename G> unsigned int target(unsigned int source,
+             *          unsigned int count, G& generator) const
+             *      Defaults to 'Ring'.
+             * @param <G> Random number engine. Defaults to 'std::mt19937'.
+             */
+            template <typename C, typename T = Ring, typename G = std::mt19937> class Islands {
+                public:
+                    /**
+                     * Random number engine type.
+                     */
+                    typedef G Generator;
+
+                public:
+                    /**
+                     * Constructor.
+                     * @param count Number of islands.
+                     * @param pSize Pool size of each island.
+                     * @param interval Number of generations between two migrations.
+                     *      No migration happens if null.
+                     * @param migrants Number of migrants, taken from the elite.
+                     * @param seed Seed from which each island seed is derived.
+                     * @param topology Migration topology.
+                     */
+                    Islands(unsigned int count, unsigned int pSize, unsigned int interval,
+                            unsigned int migrants, unsigned long seed = std::random_device()(),
+                            const T& topology = T()) : _count(count), _size(pSize),
+                            _interval(interval), _migrants(migrants), _topology(topology),
+                            _migrations(0) {
+                        std::seed_seq sequence{static_cast<unsigned int>(seed),
+                            static_cast<unsigned int>(seed >> 16 >> 16)};
+                        std::vector<unsigned int> seeds(count);
+                        sequence.generate(seeds.begin(), seeds.end());
+                        _islands = new Island[count];
+                        for(unsigned int i = 0; i < count; ++i) {
+                            _islands[i].engine = new Trivial<C, G>(pSize, seeds[i]);
+                            // Islands are the unit of parallelism.
+                            _islands[i].engine->_parallel = false;
+                        }
+                    }
+
+                    /**
+                     * Destructor.
+                     */
+                    ~Islands() {
+                        for(unsigned int i = 0; i < _count; ++i) {
+                            delete _islands[i].engine;
+                        }
+                        delete []_islands;
+                    }
+
+                    /**
+                     * Training. See 'Trivial::train' for concepts and parameters.
+                     * @return The maximal number of generations run by an island, the
+                     *      minimal error and the number of candidates stored in the
+                     *      specified buffer, best ones of all islands.
+                     */
+                    template <typename E, typename V, typename... M>
+                        std::tuple<int, double, int> train(E* env, V* visitor,
+                            unsigned int maxGen, double minErr, double eliteSize,
+                            C** store, unsigned int size,
+                            M... mutators) {
+                        unsigned int eliteCount = _size * eliteSize;
+                        for(unsigned int i = 0; i < _count; ++i) {
+                            _islands[i].engine->streams();
+                            env->reserve(_islands[i].engine->_pool, _size);
+                        }
+
+                        std::atomic<bool> done(false);
+                        std::vector<std::thread> workers;
+                        for(unsigned int i = 0; i < _count; ++i) {
+                            workers.push_back(std::thread(&Islands::template evolve<E, V, M...>,
+                                        this, i, env, visitor, maxGen, minErr, eliteCount,
+                                        &done, mutators...));
+                        }
+                        for(std::thread &worker : workers) {
+                            worker.join();
+                        }
+
+                        // At this point, every island elite is evaluated and sorted.
+                        std::vector<std::pair<double, C*> > ranking;
+                        unsigned int generation = 0;
+                        double minimum = _islands[0].minimum;
+                        for(unsigned int i = 0; i < _count; ++i) {
+                            Trivial<C, G>* engine = _islands[i].engine;
+                            generation = std::max(generation, _islands[i].generations);
+                            minimum = std::min(minimum, _islands[i].minimum);
+                            for(unsigned int j = 0; j < eliteCount && j < _size; ++j) {
+                                ranking.push_back(std::make_pair(engine->_score[j], engine->_pool[j]));
+                            }
+                        }
+                        std::stable_sort(ranking.begin(), ranking.end(),
+                                [](const std::pair<double, C*>& a, const std::pair<double, C*>& b) {
+                                    return a.first < b.first;
+                                });
+                        unsigned int number = ranking.size() < size ?
+                            static_cast<unsigned int>(ranking.size()) : size;
+                        for(unsigned int i = 0; i < number; ++i) {
+                            store[i] = env->clone(ranking[i].second);
+                        }
+
+                        // Clean-up the pools and undelivered migrants.
+                        for(unsigned int i = 0; i < _count; ++i) {
+                            env->release(_islands[i].engine->_pool, _size);
+                            std::vector<C*>& arrivals = _islands[i].arrivals;
+                            if(!arrivals.empty()) {
+                                env->release(arrivals.data(), static_cast<unsigned int>(arrivals.size()));
+                                arrivals.clear();
+                            }
+                        }
+
+                        return std::make_tuple(generation, minimum, number);
+                    }
+
+                    /**
+                     * @return Number of migrants sent so far.
+                     */
+                    unsigned long migrations() const {
+                        return _migrations.load();
+                    }
+
+                private:
+                    Islands(const Islands&) = delete;
+                    Islands& operator=(const Islands&) = delete;
+
+                    /**
+                     * An island.
+                     */
+                    struct Island {
+                        /** Population. */
+                        Trivial<C, G>*      engine;
+                        /** Mailbox lock. */
+                        std::mutex          lock;
+                        /** Mailbox of migrants. */
+                        std::vector<C*>     arrivals;
+                        /** Number of generations run. */
+                        unsigned int        generations;
+                        /** Minimal error reached. */
+                        double              minimum;
+                    };
+
+                    /**
+                     * Worker thread procedure: evolve an island until it reaches the
+                     * minimal error, the maximal generation, or another island does.
+                     */
+                    template <typename E, typename V, typename... M> void evolve(unsigned int index,
+                            E* env, V* visitor, unsigned int maxGen, double minErr,
+                            unsigned int eliteCount, std::atomic<bool>* done, M... mutators) {
+                        Island& island = _islands[index];
+                        Trivial<C, G>* engine = island.engine;
+                        unsigned int generation = 0;
+                        double minimum;
+                        for(;;) {
+                            minimum = engine->evaluate(env, eliteCount);
+                            if(minimum <= minErr || generation >= maxGen
+                                    || done->load(std::memory_order_relaxed)) {
+                                break;
+                            }
+                            if(visitor != nullptr) {
+                                std::lock_guard<std::mutex> guard(_lock);
+                                visitor->visit(engine->_pool, eliteCount);
+                            }
+                            if(_count > 1 && _interval > 0 && (generation % _interval) == _interval - 1) {
+                                emigrate(index, env, eliteCount);
+                            }
+                            engine->breed(eliteCount, mutators...);
+                            immigrate(index, env, eliteCount);
+                            ++generation;
+                        }
+                        if(minimum <= minErr) {
+                            done->store(true);
+                        }
+                        island.generations = generation;
+                        island.minimum = minimum;
+                    }
+
+                    /**
+                     * Post copies of the best candidates of an island to the
+                     * mailbox of the island designated by the topology.
+                     */
+                    template <typename E> void emigrate(unsigned int index, E* env, unsigned int eliteCount) {
+                        Trivial<C, G>* engine = _islands[index].engine;
+                        unsigned int count = _migrants < eliteCount ? _migrants : eliteCount;
+                        if(count == 0) {
+                            return;
+                        }
+                        std::vector<C*> migrants(count);
+                        {
+                            std::lock_guard<std::mutex> guard(_lock);
+                            for(unsigned int i = 0; i < count; ++i) {
+                                migrants[i] = env->clone(engine->_pool[i]);
+                            }
+                        }
+                        Island& target = _islands[_topology.target(index, _count, engine->_streams[0])];
+                        {
+                            std::lock_guard<std::mutex> guard(target.lock);
+                            target.arrivals.insert(target.arrivals.end(), migrants.begin(), migrants.end());
+                        }
+                        _migrations += count;
+                    }
+
+                    /**
+                     * Replace the last offspring of an island with the migrants
+                     * it received. Migrants beyond the offspring count are dropped.
+                     */
+                    template <typename E> void immigrate(unsigned int index, E* env, unsigned int eliteCount) {
+                        Island& island = _islands[index];
+                        std::vector<C*> arrivals;
+                        {
+                            std::lock_guard<std::mutex> guard(island.lock);
+                            arrivals.swap(island.arrivals);
+                        }
+                        if(arrivals.empty()) {
+                            return;
+                        }
+                        Trivial<C, G>* engine = island.engine;
+                        unsigned int room = _size > eliteCount ? _size - eliteCount : 0;
+                        std::lock_guard<std::mutex> guard(_lock);
+                        for(unsigned int i = 0; i < arrivals.size(); ++i) {
+                            if(i < room) {
+                                C*& slot = engine->_pool[_size - 1 - i];
+                                env->release(&slot, 1);
+                                slot = arrivals[i];
+                            } else {
+                                env->release(&arrivals[i], 1);
+                            }
+                        }
+                    }
+
+                private:
+                    /** Number of islands. */
+                    unsigned int                _count;
+                    /** Pool size of each island. */
+                    unsigned int                _size;
+                    /** Generations between two migrations. */
+                    unsigned int                _interval;
+                    /** Migrants per migration. */
+                    unsigned int                _migrants;
+                    /** Migration topology. */
+                    T                           _topology;
+                    /** Islands. */
+                    Island*                     _islands;
+                    /** Environment and visitor lock. */
+                    std::mutex                  _lock;
+                    /** Migrants sent. */
+                    std::atomic<unsigned long>  _migrations;
+            };
+
+            /**
+             * Steady state GA.
+             * There are no generations: worker threads pull candidates from a
+             * queue of candidates to evaluate and, as each result arrives, the
+             * candidate takes the place of the worst one of the pool if it does
+             * better. When the queue runs dry, the worker that finds it empty
+             * breeds a new batch out of the elite of the pool. Slow evaluations
+             * thus never hold the other workers back.
+             *
+             * The first queue is the reserved pool itself. Breeding starts once
+             * all of it is evaluated. Randomness comes from one stream per worker
+             * derived from a single seed. As workers interleave freely, runs are
+             * not reproducible from the seed.
+             * @param <C> Candidates. See 'Trivial'.
+             * @param <G> Random number engine. Defaults to 'std::mt19937'.
+             */
+            template <typename C, typename G = std::mt19937> class SteadyState {
+                public:
+                    /**
+                     * Random number engine type.
+                     */
+                    typedef G Generator;
+
+                public:
+                    /**
+                     * Constructor.
+                     * @param pSize Pool size.
+                     * @param workers Number of worker threads. Defaults to the
+                     *      number of hardware threads.
+                     * @param batch Number of candidates a worker pulls from the
+                     *      queue at once, and size of the bred batches.
+                     * @param seed Seed from which each worker stream is derived.
+                     */
+                    SteadyState(unsigned int pSize, unsigned int workers = std::thread::hardware_concurrency(),
+                            unsigned int batch = 1, unsigned long seed = std::random_device()()) :
+                        _size(pSize), _workers(workers > 0 ? workers : 1), _batch(batch > 0 ? batch : 1) {
+                        // The pool, the queue and what one batch per worker holds.
+                        _total = _size + (_workers + 1) * _batch;
+                        _storage = new C*[_total];
+                        _pool = new C*[_size];
+                        _score = new double[_size];
+                        _reverse = new double[_size];
+                        std::seed_seq sequence{static_cast<unsigned int>(seed),
+                            static_cast<unsigned int>(seed >> 16 >> 16)};
+                        std::vector<unsigned int> seeds(_workers);
+                        sequence.generate(seeds.begin(), seeds.end());
+                        for(unsigned int i = 0; i < _workers; ++i) {
+                            _streams.push_back(G(seeds[i]));
+                        }
+                    }
+
+                    /**
+                     * Destructor.
+                     */
+                    ~SteadyState() {
+                        delete []_storage;
+                        delete []_pool;
+                        delete []_score;
+                        delete []_reverse;
+                    }
+
+                    /**
+                     * Training. See 'Trivial::train' for concepts and parameters.
+                     * Batches are evaluated at once when the environment is 'Batched'.
+                     * The visitor is given the elite each time as many candidates as
+                     * the pool holds have been evaluated.
+                     * @param maxEval Maximum number of evaluations.
+                     * @return The number of evaluations, the minimal error and the
+                     *      number of candidates stored in the specified buffer.
+                     */
+                    template <typename E, typename V, typename... M>
+                        std::tuple<int, double, int> train(E* env, V* visitor,
+                            unsigned int maxEval, double minErr, double eliteSize,
+                            C** store, unsigned int size,
+                            M... mutators) {
+                        unsigned int eliteCount = _size * eliteSize;
+                        eliteCount = eliteCount < 1 ? 1 : (eliteCount > _size ? _size : eliteCount);
+                        env->reserve(_storage, _total);
+                        _queue.assign(_storage, _storage + _size);
+                        _free.assign(_storage + _size, _storage + _total);
+                        _filled = 0;
+                        _evaluations = 0;
+                        _done = false;
+
+                        std::vector<std::thread> workers;
+                        for(unsigned int i = 0; i < _workers; ++i) {
+                            workers.push_back(std::thread(&SteadyState::template work<E, V, M...>,
+                                        this, i, env, visitor, maxEval, minErr, eliteCount, mutators...));
+                        }
+                        for(std::thread &worker : workers) {
+                            worker.join();
+                        }
+
+                        unsigned int number = eliteCount < size ? eliteCount : size;
+                        number = number < _filled ? number : _filled;
+                        for(unsigned int i = 0; i < number; ++i) {
+                            store[i] = env->clone(_pool[i]);
+                        }
+
+                        // The storage still lists every reserved candidate.
+                        env->release(_storage, _total);
+                        _queue.clear();
+                        _free.clear();
+
+                        return std::make_tuple(static_cast<int>(_evaluations),
+                                _filled > 0 ? _score[0] : 0.0, number);
+                    }
+
+                private:
+                    SteadyState(const SteadyState&) = delete;
+                    SteadyState& operator=(const SteadyState&) = delete;
+
+                    /**
+                     * Worker thread procedure.
+                     */
+                    template <typename E, typename V, typename... M> void work(unsigned int index,
+                            E* env, V* visitor, unsigned int maxEval, double minErr,
+                            unsigned int eliteCount, M... mutators) {
+                        G& generator = _streams[index];
+                        std::vector<C*> batch;
+                        std::vector<double> scores(_batch);
+                        for(;;) {
+                            {
+                                std::unique_lock<std::mutex> lock(_mutex);
+                                // While the first pool is being evaluated, there is
+                                // nothing to breed from.
+                                _ready.wait(lock, [this]() {
+                                        return _done || !_queue.empty() || _filled == _size;
+                                    });
+                                if(_done) {
+                                    break;
+                                }
+                                if(_queue.empty()) {
+                                    breed(generator, eliteCount, mutators...);
+                                }
+                                batch.clear();
+                                while(batch.size() < _batch && !_queue.empty()) {
+                                    batch.push_back(_queue.front());
+                                    _queue.pop_front();
+                                }
+                            }
+
+                            unsigned int count = static_cast<unsigned int>(batch.size());
+                            evaluate(env, batch.data(), count, scores.data(),
+                                    std::integral_constant<bool, Batched<E, C>::value>());
+
+                            std::lock_guard<std::mutex> lock(_mutex);
+                            for(unsigned int i = 0; i < count; ++i) {
+                                insert(batch[i], scores[i]);
+                                if(++_evaluations % _size == 0 && visitor != nullptr) {
+                                    visitor->visit(_pool, eliteCount < _filled ? eliteCount : _filled);
+                                }
+                            }
+                            if(_evaluations >= maxEval || (_filled > 0 && _score[0] <= minErr)) {
+                                _done = true;
+                            }
+                            _ready.notify_all();
+                        }
+                    }
+
+                    /**
+                     * Breed a batch of offspring from the elite into the queue,
+                     * the lock being held.
+                     */
+                    template <typename... M> void breed(G& generator, unsigned int eliteCount,
+                            M... mutators) {
+                        // Same reverse score board as 'Trivial'.
+                        double total = 0;
+                        for(unsigned int i = 0; i < eliteCount; ++i) {
+                            _reverse[eliteCount - 1 - i] = _score[i];
+                            total += _score[i];
+                        }
+                        for(unsigned int i = 0; i < _batch && !_free.empty(); ++i) {
+                            C* offspring = _free.back();
+                            _free.pop_back();
+                            mutate(generator, total, offspring, eliteCount, mutators...);
+                            _queue.push_back(offspring);
+                        }
+                    }
+
+                    /**
+                     * Insert an evaluated candidate in the sorted pool, the lock
+                     * being held. The worst candidate, or the candidate itself if it
+                     * is not better, returns to the free list.
+                     */
+                    void insert(C* candidate, double score) {
+                        if(_filled == _size) {
+                            if(!(score < _score[_size - 1])) {
+                                _free.push_back(candidate);
+                                return;
+                            }
+                            _free.push_back(_pool[--_filled]);
+                        }
+                        unsigned int i = _filled++;
+                        for(; i > 0 && score < _score[i - 1]; --i) {
+                            _score[i] = _score[i - 1];
+                            _pool[i] = _pool[i - 1];
+                        }
+                        _score[i] = score;
+                        _pool[i] = candidate;
+                    }
+
+                    /**
+                     * Make a new offspring out of the available mutators. See 'Trivial'.
+                     */
+                    template <typename M, typename... O> void mutate(G& generator, double total,
+                            C* offspring, unsigned int count, M mutator, O... others) {
+                        std::uniform_real_distribution<double> dist(0.0, 1.0);
+                        if(dist(generator) < mutator->threshold()) {
+                            mutator->mutate(_pool, _reverse, total, count, offspring, generator);
+                        } else {
+                            mutate(generator, total, offspring, count, others...);
+                        }
+                    }
+
+                    template <typename M> void mutate(G& generator, double total,
+                            C* offspring, unsigned int count, M mutator) {
+                        mutator->mutate(_pool, _reverse, total, count, offspring, generator);
+                    }
+
+                    /**
+                     * Evaluate a batch, candidate by candidate.
+                     */
+                    template <typename E> void evaluate(E* env, C** batch, unsigned int count,
+                            double* scores, std::false_type) {
+                        for(unsigned int i = 0; i < count; ++i) {
+                            scores[i] = env->evaluate(batch[i]);
+                        }
+                    }
+
+                    /**
+                     * Evaluate a batch at once.
+                     */
+                    template <typename E> void evaluate(E* env, C** batch, unsigned int count,
+                            double* scores, std::true_type) {
+                        env->evaluate(const_cast<const C**>(batch), count, scores);
+                    }
+
+                private:
+                    /** Pool size. */
+                    unsigned int                _size;
+                    /** Number of workers. */
+                    unsigned int                _workers;
+                    /** Batch size. */
+                    unsigned int                _batch;
+                    /** Number of reserved candidates. */
+                    unsigned int                _total;
+                    /** Reserved candidates. */
+                    C**                         _storage;
+                    /** Evaluated candidates, sorted by score. */
+                    C**                         _pool;
+                    /** Pool scores. */
+                    double*                     _score;
+                    /** Reversed elite scores. */
+                    double*                     _reverse;
+                    /** Number of evaluated candidates in the pool. */
+                    unsigned int                _filled;
+                    /** Candidates to evaluate. */
+                    std::deque<C*>              _queue;
+                    /** Candidates available for breeding. */
+                    std::vector<C*>             _free;
+                    /** Per-worker random streams. */
+                    std::vector<G>              _streams;
+                    /** Number of evaluations. */
+                    unsigned int                _evaluations;
+                    /** Stop flag. */
+                    bool                        _done;
+                    /** Queue and pool lock. */
+                    std::mutex                  _mutex;
+                    /** Signaled as results arrive. */
+                    std::condition_variable     _ready;
+            };
+
+            /**
+             * Environment adaptor memoizing scores. Once a population converges,
+             * many offspring are identical to candidates already evaluated:
+             * their score is taken from a cache instead. The cache holds at most
+             * 'capacity' scores and evicts the least recently used one.
+             *
+             * Lookups are serialized by a lock and evaluation runs outside of it,
+             * so the adaptor can be evaluated concurrently whenever the wrapped
+             * environment can. Two threads missing the same candidate at once
+             * both evaluate it.
+             *
+             * If the wrapped environment is 'Batched', so is the adaptor: only
+             * the missed candidates of a batch are handed over to it.
+             * @param <E> Wrapped environment. See 'Trivial::train'.
+             * @param <C> Candidate concept.
+             * @param <H> Hash concept, defining 'Key operator()(const C*) const'.
+             *      'Key' must be equality comparable and supported by 'std::hash'.
+             *      Candidates with equal keys are supposed to have the same score:
+             *      a 64-bit hash is usually enough, the genome itself is exact.
+             */
+            template <typename E, typename C, typename H> class Cached {
+                public:
+                    /**
+                     * Cache key type.
+                     */
+                    typedef typename std::decay<decltype(std::declval<const H&>()(
+                                std::declval<const C*>()))>::type Key;
+
+                    /**
+                     * Visitor adaptor, reporting the cache counters to a visitor
+                     * after each visit, through 'void cache(unsigned long hits,
+                     * unsigned long misses)'.
+                     * @param <V> Visitor type.
+                     */
+                    template <typename V> class Visitor {
+                        public:
+                            Visitor(const Cached* cache, V* visitor) : _cache(cache), _visitor(visitor) {}
+                            void visit(C** pool, unsigned int count) {
+                                _visitor->visit(pool, count);
+                                _visitor->cache(_cache->hits(), _cache->misses());
+                            }
+                        private:
+                            const Cached* _cache;
+                            V* _visitor;
+                    };
+
+                public:
+                    /**
+                     * Constructor.
+                     * @param env Wrapped environment.
+                     * @param capacity Maximal number of cached scores. No score is
+                     *      cached if null.
+                     * @param hash Hash function.
+                     */
+                    Cached(E* env, unsigned int capacity, const H& hash = H()) :
+                        _env(env), _capacity(capacity), _hash(hash), _hits(0), _misses(0) {}
+
+                    void reserve(C**& buffer, unsigned int size) {
+                        _env->reserve(buffer, size);
+                    }
+
+                    void release(C** buffer, unsigned int size) {
+                        _env->release(buffer, size);
+                    }
+
+                    C* clone(const C* candidate) {
+                        return _env->clone(candidate);
+                    }
+
+                    /**
+                     * Evaluate a candidate, unless its score is cached.
+                     * @param candidate Candidate.
+                     * @return Candidate score.
+                     */
+                    double evaluate(const C* candidate) {
+                        Key key = _hash(candidate);
+                        double score;
+                        if(!lookup(key, score)) {
+                            score = _env->evaluate(candidate);
+                            store(key, score);
+                        }
+                        return score;
+                    }
+
+                    /**
+                     * Evaluate a batch, handing the missed candidates over to the wrapped
+                     * environment at once. Only available for batched environments.
+                     * @param candidates Candidates.
+                     * @param count Number of candidates.
+                     * @param scores Candidate scores.
+                     */
+                    template <typename F = E> typename std::enable_if<Batched<F, C>::value>::type
+                        evaluate(const C** candidates, unsigned int count, double* scores) {
+                            std::vector<Key> keys;
+                            std::vector<unsigned int> missed;
+                            std::vector<const C*> batch;
+                            for(unsigned int i = 0; i < count; ++i) {
+                                keys.push_back(_hash(candidates[i]));
+                                if(!lookup(keys[i], scores[i])) {
+                                    missed.push_back(i);
+                                    batch.push_back(candidates[i]);
+                                }
+                            }
+                            if(!batch.empty()) {
+                                std::vector<double> results(batch.size());
+                                _env->evaluate(batch.data(), static_cast<unsigned int>(batch.size()),
+                                        results.data());
+                                for(unsigned int i = 0; i < missed.size(); ++i) {
+                                    scores[missed[i]] = results[i];
+                                    store(keys[missed[i]], results[i]);
+                                }
+                            }
+                        }
+
+                    /**
+                     * @return Number of scores taken from the cache.
+                     */
+                    unsigned long hits() const {
+                        return _hits.load();
+                    }
+
+                    /**
+                     * @return Number of scores evaluated.
+                     */
+                    unsigned long misses() const {
+                        return _misses.load();
+                    }
+
+                    /**
+                     * Drop the cached scores and reset the counters, e.g. when the
+                     * wrapped environment changes.
+                     */
+                    void clear() {
+                        std::lock_guard<std::mutex> lock(_mutex);
+                        _entries.clear();
+                        _index.clear();
+                        _hits = 0;
+                        _misses = 0;
+                    }
+
+                private:
+                    Cached(const Cached&) = delete;
+                    Cached& operator=(const Cached&) = delete;
+
+                    typedef std::list<std::pair<Key, double> > Entries;
+
+                    /**
+                     * Look a score up, marking it as the most recently used.
+                     * @return false if not cached.
+                     */
+                    bool lookup(const Key& key, double& score) {
+                        std::lock_guard<std::mutex> lock(_mutex);
+                        auto found = _index.find(key);
+                        if(found == _index.end()) {
+                            ++_misses;
+                            return false;
+                        }
+                        _entries.splice(_entries.begin(), _entries, found->second);
+                        score = found->second->second;
+                        ++_hits;
+                        return true;
+                    }
+
+                    /**
+                     * Cache a score, evicting the least recently used one if full.
+                     */
+                    void store(const Key& key, double score) {
+                        if(_capacity == 0) {
+                            return;
+                        }
+                        std::lock_guard<std::mutex> lock(_mutex);
+                        if(_index.find(key) != _index.end()) {
+                            return;
+                        }
+                        _entries.push_front(std::make_pair(key, score));
+                        _index[key] = _entries.begin();
+                        if(_entries.size() > _capacity) {
+                            _index.erase(_entries.back().first);
+                            _entries.pop_back();
+                        }
+                    }
+
+                private:
+                    /** Wrapped environment. */
+                    E*                                                      _env;
+                    /** Maximal number of cached scores. */
+                    unsigned int                                            _capacity;
+                    /** Hash function. */
+                    H                                                       _hash;
+                    /** Cached scores, most recently used first. */
+                    Entries                                                 _entries;
+                    /** Cached scores by key. */
+                    std::unordered_map<Key, typename Entries::iterator>     _index;
+                    /** Hit counter. */
+                    std::atomic<unsigned long>                              _hits;
+                    /** Miss counter. */
+                    std::atomic<unsigned long>                              _misses;
+                    /** Cache lock. */
+                    std::mutex                                              _mutex;
             };
 
         } // Namespace 'GA'
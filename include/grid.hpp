@@ -0,0 +1,586 @@
+/*
+ * Copyright 2016 Stoned Xander
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HEADLESS_LOGIC_GRID
+#define HEADLESS_LOGIC_GRID
+
+#include <cstring>
+#include <utility>
+
+// Concepts and defaults are shared with the linked tree.
+#include "searchtree.hpp"
+
+#define GRID_DEPTH 6
+#define GRID_MAX_CELLS (1u << 24)
+#define GRID_SCAN_SIZE 32
+
+namespace Headless {
+    namespace Logic {
+        namespace SearchTree {
+
+            /**
+             * Uniform Grid.
+             *
+             * Same operations and concepts as 'Node', meant for elements
+             * searched with a fixed and roughly uniform radius. The region is
+             * divided uniformly down to a fixed depth, each finest sub-region
+             * being a cell. Elements are stored by cell in a single array,
+             * cells referring to their range through an offset table, and the
+             * whole array is rebuilt by counting sort on batch updates.
+             *
+             * Searches walk the (complete, implicit) hierarchy of sub-regions,
+             * so that they are pruned as in the trees, then scan cells.
+             * Single insertions and removals shift the array and the offset
+             * table (linear cost): use 'moveAll' or 'build' every tick.
+             *
+             * Regions must be default constructible, assignable, and implement
+             * 'FANOUT' and 'divide(R*)', as well as 'index' unless they encode
+             * keys with 'code' (see 'MortonTree').
+             * @param <K> Key concept. See 'Node'.
+             * @param <R> Region concept. See 'Node'.
+             * @param <E> Element concept. See 'Node'.
+             */
+            template <typename K, typename R, typename E> class Grid {
+                static_assert(Fanout<R>::value > 1, "Regions must declare their fan-out.");
+                static_assert(Indexable<R, K>::value || Encodable<R, K>::value,
+                        "Regions must index their sub-regions or encode keys.");
+                static_assert(Divisible<R>::value, "Regions must divide into a provided storage.");
+                public:
+                    /**
+                     * Default visitor.
+                     */
+                    class Visitor {
+                        public:
+                            void enter(const R&) {}
+                            void exit(const R&) {}
+                            void inspect(E**, unsigned int) {}
+                            void inspect(E*) {}
+                    };
+                public:
+                    /**
+                     * Constructor.
+                     * @param region Region covered by the grid.
+                     * @param depth Subdivision depth, clamped so that the grid
+                     * has at most GRID_MAX_CELLS cells.
+                     */
+                    Grid(const R* region, unsigned int depth = GRID_DEPTH);
+                    /**
+                     * Destructor.
+                     */
+                    ~Grid();
+                    /**
+                     * Add an element.
+                     * @param element Pointer to the element to add.
+                     * @return false if the element key is outside the region.
+                     */
+                    bool add(E* element);
+                    /**
+                     * Remove an element.
+                     * @param element Pointer to the element instance to remove.
+                     */
+                    void remove(E* element);
+                    /**
+                     * Move an element within the grid.
+                     * @param element Element to be moved.
+                     * @param key Target key.
+                     */
+                    void move(E* element, K &key);
+                    /**
+                     * Move a batch of elements, then rebuild the grid.
+                     * @param elements Elements to be moved.
+                     * @param keys Target keys, one per element.
+                     * @param count Number of elements.
+                     */
+                    void moveAll(E** elements, K* keys, unsigned int count);
+                    /**
+                     * Replace the content of the grid with a batch of elements.
+                     * Elements outside the region are ignored.
+                     * @param elements Elements to store.
+                     * @param count Number of elements.
+                     */
+                    void build(E** elements, unsigned int count);
+                    /**
+                     * Retrieve elements matching a search function.
+                     * @param func Search function. See 'Node::retrieve'.
+                     * @param buffer Storage for eligible elements.
+                     * @param size Size of the buffer.
+                     * @param visitor Optional visitor.
+                     * @param overflow Optional flag, set to true if there are more
+                     * eligible elements than 'size'.
+                     * @return Number of elements stored in the buffer.
+                     */
+                    template <typename S, typename V = Visitor> unsigned int retrieve(const S& func,
+                            E** buffer, unsigned int size, V* visitor = nullptr,
+                            bool* overflow = nullptr) const;
+                    /**
+                     * Stream the elements matching a search function to a sink.
+                     * See 'Node::retrieve'.
+                     * @param func Search function.
+                     * @param sink Element consumer.
+                     * @param visitor Optional visitor.
+                     * @return false if the sink stopped the search.
+                     */
+                    template <typename S, typename C, typename V = Visitor> bool retrieve(const S& func,
+                            C& sink, V* visitor = nullptr) const;
+                    /**
+                     * Run a batch of retrievals, spread over threads when compiled
+                     * with OpenMP. See 'Node::retrieveAll'.
+                     * @param queries Query provider.
+                     * @param count Number of queries.
+                     * @param size Size of the per-thread buffers.
+                     * @param consumer Result consumer.
+                     */
+                    template <typename Q, typename C> void retrieveAll(const Q& queries,
+                            unsigned int count, unsigned int size, C& consumer) const;
+                    /**
+                     * Recursive visit of the implicit hierarchy, cells being leaves.
+                     * See 'Node::visit'.
+                     * @param visitor Visitor.
+                     */
+                    template <typename V> void visit(V& visitor);
+
+                private:
+                    Grid(const Grid&) = delete;
+                    Grid& operator=(const Grid&) = delete;
+
+                    /**
+                     * Cell of a key, assumed to be within the region.
+                     * @param key Key to locate.
+                     * @return Cell index.
+                     */
+                    unsigned int cell(const K& key) const {
+                        return cell(key, std::integral_constant<bool, Encodable<R, K>::value>());
+                    }
+                    unsigned int cell(const K& key, std::true_type) const {
+                        return static_cast<unsigned int>(_region.code(key, _depth));
+                    }
+                    unsigned int cell(const K& key, std::false_type) const;
+                    /**
+                     * Find the position of a stored element.
+                     * @param element Element to look for.
+                     * @return Its position, or the element count if not stored.
+                     */
+                    unsigned int position(E* element) const;
+                    /**
+                     * Grow storage.
+                     * @param capacity Minimum number of elements.
+                     */
+                    void reserve(unsigned int capacity);
+                    /**
+                     * Move a range of entries (elements and keys).
+                     * @param target Target position.
+                     * @param source Source position.
+                     * @param count Number of entries.
+                     */
+                    void shift(unsigned int target, unsigned int source, unsigned int count);
+                    /**
+                     * Sort the stored entries by cell (counting sort), discarding
+                     * the ones outside the region.
+                     */
+                    void rebuild();
+
+                    template <typename S, typename C, typename V> bool retrieve(const R& region,
+                            unsigned int span, unsigned int first, const S& func, C& sink, V* visitor) const;
+                    template <typename C, typename V> bool fetch(const R& region,
+                            unsigned int begin, unsigned int end, C& sink, V* visitor) const;
+                    template <typename S, typename C, typename V> bool scan(unsigned int begin,
+                            unsigned int end, const S& func, C& sink, V* visitor, std::true_type) const;
+                    template <typename S, typename C, typename V> bool scan(unsigned int begin,
+                            unsigned int end, const S& func, C& sink, V* visitor, std::false_type) const;
+                    template <typename V> void visit(const R& region, unsigned int span,
+                            unsigned int first, V& visitor);
+
+                private:
+                    /** Region covered by the grid. */
+                    R                        _region;
+                    /** Elements, by cell. */
+                    E**                      _elements;
+                    /** Element keys, by cell. */
+                    K*                       _keys;
+                    /** Rebuild storage. */
+                    E**                      _spareElements;
+                    K*                       _spareKeys;
+                    /** Cell of each entry, during rebuilds. */
+                    unsigned int*            _codes;
+                    /** First entry of each cell, plus the entry count. */
+                    unsigned int*            _offsets;
+                    /** Number of stored elements. */
+                    unsigned int             _count;
+                    /** Number of allocated entries. */
+                    unsigned int             _capacity;
+                    /** Subdivision depth. */
+                    unsigned int             _depth;
+                    /** Number of cells. */
+                    unsigned int             _cells;
+            };
+
+            template <typename K, typename R, typename E>
+                Grid<K, R, E>::Grid(const R* region, unsigned int depth) :
+                    _region(*region), _count(0), _capacity(DEFAULT_CARD), _depth(0), _cells(1) {
+                        while(_depth < depth && _cells <= GRID_MAX_CELLS / Fanout<R>::value) {
+                            _cells *= Fanout<R>::value;
+                            ++_depth;
+                        }
+                        _elements = new E*[_capacity];
+                        _keys = new K[_capacity];
+                        _spareElements = new E*[_capacity];
+                        _spareKeys = new K[_capacity];
+                        _codes = new unsigned int[_capacity];
+                        _offsets = new unsigned int[_cells + 1];
+                        std::memset(_offsets, 0, (_cells + 1) * sizeof(unsigned int));
+                    }
+
+            template <typename K, typename R, typename E>
+                Grid<K, R, E>::~Grid() {
+                    delete []_elements;
+                    delete []_keys;
+                    delete []_spareElements;
+                    delete []_spareKeys;
+                    delete []_codes;
+                    delete []_offsets;
+                }
+
+            template <typename K, typename R, typename E>
+                unsigned int Grid<K, R, E>::cell(const K& key, std::false_type) const {
+                    unsigned int result = 0;
+                    R region = _region;
+                    R regions[Fanout<R>::value];
+                    for(unsigned int level = 0; level < _depth; ++level) {
+                        unsigned int index = region.index(key);
+                        result = result * Fanout<R>::value + index;
+                        if(level + 1 < _depth) {
+                            region.divide(regions);
+                            region = regions[index];
+                        }
+                    }
+                    return result;
+                }
+
+            template <typename K, typename R, typename E>
+                unsigned int Grid<K, R, E>::position(E* element) const {
+                    unsigned int result = _count;
+                    const K& key = element->key();
+                    if(_region.contains(key)) {
+                        unsigned int index = cell(key);
+                        for(unsigned int i = _offsets[index]; i < _offsets[index + 1]; ++i) {
+                            if(element == _elements[i]) {
+                                result = i;
+                                break;
+                            }
+                        }
+                    }
+                    return result;
+                }
+
+            template <typename K, typename R, typename E>
+                void Grid<K, R, E>::reserve(unsigned int capacity) {
+                    if(capacity > _capacity) {
+                        unsigned int size = _capacity * 2;
+                        if(size < capacity) {
+                            size = capacity;
+                        }
+                        E** elements = new E*[size];
+                        K* keys = new K[size];
+                        std::memcpy(elements, _elements, _count * sizeof(E*));
+                        std::memcpy(keys, _keys, _count * sizeof(K));
+                        delete []_elements;
+                        delete []_keys;
+                        delete []_spareElements;
+                        delete []_spareKeys;
+                        delete []_codes;
+                        _elements = elements;
+                        _keys = keys;
+                        _spareElements = new E*[size];
+                        _spareKeys = new K[size];
+                        _codes = new unsigned int[size];
+                        _capacity = size;
+                    }
+                }
+
+            template <typename K, typename R, typename E>
+                void Grid<K, R, E>::shift(unsigned int target, unsigned int source, unsigned int count) {
+                    std::memmove(_elements + target, _elements + source, count * sizeof(E*));
+                    std::memmove(_keys + target, _keys + source, count * sizeof(K));
+                }
+
+            template <typename K, typename R, typename E>
+                void Grid<K, R, E>::rebuild() {
+                    // Count elements by cell, entries outside the region are marked
+                    // with the cell count.
+                    std::memset(_offsets, 0, (_cells + 1) * sizeof(unsigned int));
+                    unsigned int inside = 0;
+                    for(unsigned int i = 0; i < _count; ++i) {
+                        unsigned int index = _region.contains(_keys[i]) ? cell(_keys[i]) : _cells;
+                        _codes[i] = index;
+                        if(index < _cells) {
+                            ++_offsets[index + 1];
+                            ++inside;
+                        }
+                    }
+                    for(unsigned int i = 1; i <= _cells; ++i) {
+                        _offsets[i] += _offsets[i - 1];
+                    }
+                    // Scatter, offsets being turned into cell ends.
+                    for(unsigned int i = 0; i < _count; ++i) {
+                        unsigned int index = _codes[i];
+                        if(index < _cells) {
+                            unsigned int target = _offsets[index]++;
+                            _spareElements[target] = _elements[i];
+                            _spareKeys[target] = _keys[i];
+                        }
+                    }
+                    // Back to cell starts.
+                    for(unsigned int i = _cells; i > 0; --i) {
+                        _offsets[i] = _offsets[i - 1];
+                    }
+                    _offsets[0] = 0;
+                    std::swap(_spareElements, _elements);
+                    std::swap(_spareKeys, _keys);
+                    _count = inside;
+                }
+
+            template <typename K, typename R, typename E>
+                bool Grid<K, R, E>::add(E* element) {
+                    const K& key = element->key();
+                    bool result = _region.contains(key);
+                    if(result) {
+                        unsigned int index = cell(key);
+                        reserve(_count + 1);
+                        unsigned int target = _offsets[index + 1];
+                        shift(target + 1, target, _count - target);
+                        _elements[target] = element;
+                        _keys[target] = key;
+                        ++_count;
+                        for(unsigned int i = index + 1; i <= _cells; ++i) {
+                            ++_offsets[i];
+                        }
+                    }
+                    return result;
+                }
+
+            template <typename K, typename R, typename E>
+                void Grid<K, R, E>::remove(E* element) {
+                    unsigned int source = position(element);
+                    if(source < _count) {
+                        unsigned int index = cell(_keys[source]);
+                        --_count;
+                        shift(source, source + 1, _count - source);
+                        for(unsigned int i = index + 1; i <= _cells; ++i) {
+                            --_offsets[i];
+                        }
+                    }
+                }
+
+            template <typename K, typename R, typename E>
+                void Grid<K, R, E>::move(E* element, K& key) {
+                    unsigned int source = position(element);
+                    if(source < _count && _region.contains(key) && cell(key) == cell(_keys[source])) {
+                        // Still in its cell.
+                        _keys[source] = key;
+                        element->key(key);
+                    } else {
+                        remove(element);
+                        element->key(key);
+                        add(element);
+                    }
+                }
+
+            template <typename K, typename R, typename E>
+                void Grid<K, R, E>::moveAll(E** elements, K* keys, unsigned int count) {
+                    // Update the keys of stored elements while their cells are still
+                    // valid, append the others.
+                    reserve(_count + count);
+                    unsigned int appended = _count;
+                    for(unsigned int i = 0; i < count; ++i) {
+                        unsigned int pos = position(elements[i]);
+                        if(pos == _count) {
+                            pos = appended;
+                            _elements[pos] = elements[i];
+                            ++appended;
+                        }
+                        _keys[pos] = keys[i];
+                        elements[i]->key(keys[i]);
+                    }
+                    _count = appended;
+                    rebuild();
+                }
+
+            template <typename K, typename R, typename E>
+                void Grid<K, R, E>::build(E** elements, unsigned int count) {
+                    reserve(count);
+                    for(unsigned int i = 0; i < count; ++i) {
+                        _elements[i] = elements[i];
+                        _keys[i] = elements[i]->key();
+                    }
+                    _count = count;
+                    rebuild();
+                }
+
+            template <typename K, typename R, typename E>
+                template <typename S, typename V>
+                unsigned int Grid<K, R, E>::retrieve(const S& func, E** buffer, unsigned int size,
+                        V* visitor, bool* overflow) const {
+                    Collector<E> collector(buffer, size);
+                    retrieve(func, collector, visitor);
+                    if(nullptr != overflow) {
+                        *overflow = collector.overflow();
+                    }
+                    return collector.count();
+                }
+
+            template <typename K, typename R, typename E>
+                template <typename S, typename C, typename V>
+                bool Grid<K, R, E>::retrieve(const S& func, C& sink, V* visitor) const {
+                    return retrieve(_region, _cells, 0, func, sink, visitor);
+                }
+
+            template <typename K, typename R, typename E>
+                template <typename Q, typename C>
+                void Grid<K, R, E>::retrieveAll(const Q& queries, unsigned int count,
+                        unsigned int size, C& consumer) const {
+                    #pragma omp parallel
+                    {
+                        E** buffer = new E*[size];
+                        #pragma omp for schedule(dynamic, BATCH_CHUNK_SIZE)
+                        for(unsigned int i = 0; i < count; ++i) {
+                            unsigned int retrieved = retrieve(queries(i), buffer, size);
+                            consumer(i, buffer, retrieved);
+                        }
+                        delete []buffer;
+                    }
+                }
+
+            template <typename K, typename R, typename E>
+                template <typename S, typename C, typename V>
+                bool Grid<K, R, E>::retrieve(const R& region, unsigned int span, unsigned int first,
+                        const S& func, C& sink, V* visitor) const {
+                    bool result = true;
+                    if(nullptr != visitor) {
+                        visitor->enter(region);
+                    }
+                    unsigned int begin = _offsets[first];
+                    unsigned int end = _offsets[first + span];
+                    if(1 == span || end - begin <= GRID_SCAN_SIZE) {
+                        // Scanning a few entries is cheaper than descending.
+                        result = scan(begin, end, func, sink, visitor,
+                                std::integral_constant<bool, Batched<S, K>::value>());
+                    } else {
+                        R regions[Fanout<R>::value];
+                        region.divide(regions);
+                        unsigned int sub = span / Fanout<R>::value;
+                        for(unsigned int i = 0; i < Fanout<R>::value && result; ++i) {
+                            unsigned int child = first + i * sub;
+                            if(_offsets[child] < _offsets[child + sub]) {
+                                int intersects = func.contains(regions[i]);
+                                if(intersects > 0) {
+                                    result = fetch(regions[i], _offsets[child], _offsets[child + sub],
+                                            sink, visitor);
+                                } else if(intersects == 0) {
+                                    result = retrieve(regions[i], sub, child, func, sink, visitor);
+                                }
+                            }
+                        }
+                    }
+                    if(nullptr != visitor) {
+                        visitor->exit(region);
+                    }
+                    return result;
+                }
+
+            template <typename K, typename R, typename E>
+                template <typename C, typename V>
+                bool Grid<K, R, E>::fetch(const R& region, unsigned int begin, unsigned int end,
+                        C& sink, V* visitor) const {
+                    bool result = true;
+                    if(nullptr != visitor) {
+                        visitor->enter(region);
+                        visitor->inspect(_elements + begin, end - begin);
+                    }
+                    for(unsigned int i = begin; i < end && result; ++i) {
+                        result = sink(_elements[i]);
+                    }
+                    if(nullptr != visitor) {
+                        visitor->exit(region);
+                    }
+                    return result;
+                }
+
+            template <typename K, typename R, typename E>
+                template <typename S, typename C, typename V>
+                bool Grid<K, R, E>::scan(unsigned int begin, unsigned int end, const S& func,
+                        C& sink, V* visitor, std::false_type) const {
+                    bool result = true;
+                    for(unsigned int i = begin; i < end && result; ++i) {
+                        if(func.contains(_keys[i])) {
+                            if(nullptr != visitor) {
+                                visitor->inspect(_elements[i]);
+                            }
+                            result = sink(_elements[i]);
+                        }
+                    }
+                    return result;
+                }
+
+            template <typename K, typename R, typename E>
+                template <typename S, typename C, typename V>
+                bool Grid<K, R, E>::scan(unsigned int begin, unsigned int end, const S& func,
+                        C& sink, V* visitor, std::true_type) const {
+                    bool result = true;
+                    unsigned char mask[SCAN_BLOCK_SIZE];
+                    for(unsigned int start = begin; start < end && result; start += SCAN_BLOCK_SIZE) {
+                        unsigned int block = end - start < SCAN_BLOCK_SIZE ? end - start : SCAN_BLOCK_SIZE;
+                        func.contains(_keys + start, block, mask);
+                        for(unsigned int i = 0; i < block && result; ++i) {
+                            if(0 != mask[i]) {
+                                E* element = _elements[start + i];
+                                if(nullptr != visitor) {
+                                    visitor->inspect(element);
+                                }
+                                result = sink(element);
+                            }
+                        }
+                    }
+                    return result;
+                }
+
+            template <typename K, typename R, typename E>
+                template <typename V>
+                void Grid<K, R, E>::visit(V& visitor) {
+                    visit(_region, _cells, 0, visitor);
+                }
+
+            template <typename K, typename R, typename E>
+                template <typename V>
+                void Grid<K, R, E>::visit(const R& region, unsigned int span, unsigned int first,
+                        V& visitor) {
+                    visitor.enter(region);
+                    if(1 == span) {
+                        visitor.inspect(_elements + _offsets[first], _offsets[first + 1] - _offsets[first]);
+                    } else {
+                        R regions[Fanout<R>::value];
+                        region.divide(regions);
+                        unsigned int sub = span / Fanout<R>::value;
+                        for(unsigned int i = 0; i < Fanout<R>::value; ++i) {
+                            visit(regions[i], sub, first + i * sub, visitor);
+                        }
+                    }
+                    visitor.exit(region);
+                }
+
+        } // Namespace 'SearchTree'
+    } // Namespace 'Logic'
+} // Namespace 'Headless'
+
+#endif
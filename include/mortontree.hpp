@@ -0,0 +1,676 @@
+/*
+ * Copyright 2016 Stoned Xander
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HEADLESS_LOGIC_MORTON_TREE
+#define HEADLESS_LOGIC_MORTON_TREE
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+// Concepts and defaults are shared with the linked tree.
+#include "searchtree.hpp"
+
+#define MORTON_DEPTH 10
+#define MORTON_RADIX_BITS 11
+
+namespace Headless {
+    namespace Logic {
+        namespace SearchTree {
+
+            /**
+             * Morton Search Tree (linear tree).
+             *
+             * Same operations and concepts as 'Node', but no node is stored.
+             * Each element is given a code made of the sub-region indices of
+             * its key, from the root down to a fixed depth. Elements are kept
+             * sorted by code in parallel arrays (codes, elements and keys), so
+             * that any sub-region of the implicit tree is a contiguous range,
+             * found by binary search. When the region orders its sub-regions
+             * in Z-order, codes are Morton codes.
+             *
+             * The implicit tree is the one 'Node::build' would produce: a
+             * sub-region is divided as long as it holds more elements than the
+             * cardinality, and up to the code depth.
+             *
+             * Insertions and removals shift the arrays (linear cost), the tree
+             * is meant for batch updates: 'build' sorts once, 'moveAll' re-sorts
+             * nearly sorted codes.
+             *
+             * In addition to the 'Node' requirements, regions must be default
+             * constructible, assignable, and implement 'FANOUT', 'index' and
+             * 'divide(R*)'. Encoding divides the region down to the code depth,
+             * unless the region implements:
+             *     unsigned long long code(const K&, unsigned int depth) const;
+             * which must give the same digits as 'index' (base 'FANOUT', most
+             * significant first) without building the sub-regions.
+             * @param <K> Key concept. See 'Node'.
+             * @param <R> Region concept. See 'Node'.
+             * @param <E> Element concept. See 'Node'.
+             */
+            template <typename K, typename R, typename E> class MortonTree {
+                static_assert(Fanout<R>::value > 1, "Regions must declare their fan-out.");
+                static_assert(Indexable<R, K>::value, "Regions must index their sub-regions.");
+                static_assert(Divisible<R>::value, "Regions must divide into a provided storage.");
+                public:
+                    /**
+                     * Element code.
+                     */
+                    typedef unsigned long long Code;
+                    /**
+                     * Default visitor.
+                     */
+                    class Visitor {
+                        public:
+                            void enter(const R&) {}
+                            void exit(const R&) {}
+                            void inspect(E**, unsigned int) {}
+                            void inspect(E*) {}
+                    };
+                public:
+                    /**
+                     * Constructor.
+                     * @param region Region covered by the tree.
+                     * @param cardinality Maximum number of elements per leaf of the
+                     * implicit tree.
+                     * @param depth Code depth, clamped so that codes fit a 'Code'.
+                     */
+                    MortonTree(const R* region, unsigned int cardinality = DEFAULT_CARD,
+                            unsigned int depth = MORTON_DEPTH);
+                    /**
+                     * Destructor.
+                     */
+                    ~MortonTree();
+                    /**
+                     * Add an element.
+                     * @param element Pointer to the element to add.
+                     * @return false if the element key is outside the region.
+                     */
+                    bool add(E* element);
+                    /**
+                     * Remove an element.
+                     * @param element Pointer to the element instance to remove.
+                     */
+                    void remove(E* element);
+                    /**
+                     * Move an element within the tree. Only the elements between
+                     * the former and the new position are shifted.
+                     * @param element Element to be moved.
+                     * @param key Target key.
+                     */
+                    void move(E* element, K &key);
+                    /**
+                     * Move a batch of elements within the tree, re-sorting once.
+                     * @param elements Elements to be moved.
+                     * @param keys Target keys, one per element.
+                     * @param count Number of elements.
+                     */
+                    void moveAll(E** elements, K* keys, unsigned int count);
+                    /**
+                     * Replace the content of the tree with a batch of elements.
+                     * Elements outside the region are ignored.
+                     * @param elements Elements to store.
+                     * @param count Number of elements.
+                     */
+                    void build(E** elements, unsigned int count);
+                    /**
+                     * Retrieve elements matching a search function.
+                     * @param func Search function. See 'Node::retrieve'.
+                     * @param buffer Storage for eligible elements.
+                     * @param size Size of the buffer.
+                     * @param visitor Optional visitor.
+                     * @param overflow Optional flag, set to true if there are more
+                     * eligible elements than 'size'.
+                     * @return Number of elements stored in the buffer.
+                     */
+                    template <typename S, typename V = Visitor> unsigned int retrieve(const S& func,
+                            E** buffer, unsigned int size, V* visitor = nullptr,
+                            bool* overflow = nullptr) const;
+                    /**
+                     * Stream the elements matching a search function to a sink.
+                     * See 'Node::retrieve'.
+                     * @param func Search function.
+                     * @param sink Element consumer.
+                     * @param visitor Optional visitor.
+                     * @return false if the sink stopped the search.
+                     */
+                    template <typename S, typename C, typename V = Visitor> bool retrieve(const S& func,
+                            C& sink, V* visitor = nullptr) const;
+                    /**
+                     * Run a batch of retrievals, spread over threads when compiled
+                     * with OpenMP. See 'Node::retrieveAll'.
+                     * @param queries Query provider.
+                     * @param count Number of queries.
+                     * @param size Size of the per-thread buffers.
+                     * @param consumer Result consumer.
+                     */
+                    template <typename Q, typename C> void retrieveAll(const Q& queries,
+                            unsigned int count, unsigned int size, C& consumer) const;
+                    /**
+                     * Recursive visit of the implicit tree. See 'Node::visit'.
+                     * @param visitor Visitor.
+                     */
+                    template <typename V> void visit(V& visitor);
+
+                private:
+                    MortonTree(const MortonTree&) = delete;
+                    MortonTree& operator=(const MortonTree&) = delete;
+
+                    /**
+                     * Code of a key, assumed to be within the region.
+                     * @param key Key to encode.
+                     * @return Sub-region indices, most significant first.
+                     */
+                    Code encode(const K& key) const {
+                        return encode(key, std::integral_constant<bool, Encodable<R, K>::value>());
+                    }
+                    Code encode(const K& key, std::true_type) const { return _region.code(key, _depth); }
+                    Code encode(const K& key, std::false_type) const;
+                    /**
+                     * Find the position of a stored element.
+                     * @param element Element to look for.
+                     * @return Its position, or the element count if not stored.
+                     */
+                    unsigned int position(E* element) const;
+                    /**
+                     * @return Position of the first code not less than 'code' in [first, last).
+                     */
+                    unsigned int lower(unsigned int first, unsigned int last, Code code) const {
+                        return std::lower_bound(_codes + first, _codes + last, code) - _codes;
+                    }
+                    /**
+                     * @return Position of the first code greater than 'code' in [first, last).
+                     */
+                    unsigned int upper(unsigned int first, unsigned int last, Code code) const {
+                        return std::upper_bound(_codes + first, _codes + last, code) - _codes;
+                    }
+                    /**
+                     * Grow storage.
+                     * @param capacity Minimum number of elements.
+                     */
+                    void reserve(unsigned int capacity);
+                    /**
+                     * Move a range of entries (codes, elements and keys).
+                     * @param target Target position.
+                     * @param source Source position.
+                     * @param count Number of entries.
+                     */
+                    void shift(unsigned int target, unsigned int source, unsigned int count);
+                    /**
+                     * Sort entries by code, in place. Fast on nearly sorted entries.
+                     */
+                    void settle();
+                    /**
+                     * Sort entries by code. Codes must not exceed '_span'.
+                     */
+                    void sort();
+
+                    template <typename S, typename C, typename V> bool retrieve(const R& region,
+                            Code span, Code first, unsigned int begin, unsigned int end,
+                            const S& func, C& sink, V* visitor) const;
+                    template <typename C, typename V> bool fetch(const R& region,
+                            unsigned int begin, unsigned int end, C& sink, V* visitor) const;
+                    template <typename S, typename C, typename V> bool scan(unsigned int begin,
+                            unsigned int end, const S& func, C& sink, V* visitor, std::true_type) const;
+                    template <typename S, typename C, typename V> bool scan(unsigned int begin,
+                            unsigned int end, const S& func, C& sink, V* visitor, std::false_type) const;
+                    template <typename V> void visit(const R& region, Code span, Code first,
+                            unsigned int begin, unsigned int end, V& visitor);
+
+                private:
+                    /** Region covered by the tree. */
+                    R                        _region;
+                    /** Sorted element codes. */
+                    Code*                    _codes;
+                    /** Elements, by code. */
+                    E**                      _elements;
+                    /** Element keys, by code. */
+                    K*                       _keys;
+                    /** Sort storage, allocated by the first sort. */
+                    Code*                    _spare;
+                    E**                      _spareElements;
+                    K*                       _spareKeys;
+                    /** Number of stored elements. */
+                    unsigned int             _count;
+                    /** Number of allocated entries. */
+                    unsigned int             _capacity;
+                    /** Maximum number of elements per leaf. */
+                    unsigned int             _cardinality;
+                    /** Code depth. */
+                    unsigned int             _depth;
+                    /** Number of codes (fan-out to the power of depth). */
+                    Code                     _span;
+            };
+
+            template <typename K, typename R, typename E>
+                MortonTree<K, R, E>::MortonTree(const R* region, unsigned int cardinality, unsigned int depth) :
+                    _region(*region), _spare(nullptr), _spareElements(nullptr), _spareKeys(nullptr),
+                    _count(0), _capacity(DEFAULT_CARD), _cardinality(cardinality), _depth(0), _span(1) {
+                        while(_depth < depth && _span <= ~Code(0) / Fanout<R>::value) {
+                            _span *= Fanout<R>::value;
+                            ++_depth;
+                        }
+                        _codes = new Code[_capacity];
+                        _elements = new E*[_capacity];
+                        _keys = new K[_capacity];
+                    }
+
+            template <typename K, typename R, typename E>
+                MortonTree<K, R, E>::~MortonTree() {
+                    delete []_codes;
+                    delete []_elements;
+                    delete []_keys;
+                    delete []_spare;
+                    delete []_spareElements;
+                    delete []_spareKeys;
+                }
+
+            template <typename K, typename R, typename E>
+                typename MortonTree<K, R, E>::Code MortonTree<K, R, E>::encode(const K& key,
+                        std::false_type) const {
+                    Code result = 0;
+                    R region = _region;
+                    R regions[Fanout<R>::value];
+                    for(unsigned int level = 0; level < _depth; ++level) {
+                        unsigned int index = region.index(key);
+                        result = result * Fanout<R>::value + index;
+                        if(level + 1 < _depth) {
+                            region.divide(regions);
+                            region = regions[index];
+                        }
+                    }
+                    return result;
+                }
+
+            template <typename K, typename R, typename E>
+                unsigned int MortonTree<K, R, E>::position(E* element) const {
+                    unsigned int result = _count;
+                    const K& key = element->key();
+                    if(_region.contains(key)) {
+                        Code code = encode(key);
+                        for(unsigned int i = lower(0, _count, code); i < _count && _codes[i] == code; ++i) {
+                            if(element == _elements[i]) {
+                                result = i;
+                                break;
+                            }
+                        }
+                    }
+                    return result;
+                }
+
+            template <typename K, typename R, typename E>
+                void MortonTree<K, R, E>::reserve(unsigned int capacity) {
+                    if(capacity > _capacity) {
+                        unsigned int size = _capacity * 2;
+                        if(size < capacity) {
+                            size = capacity;
+                        }
+                        Code* codes = new Code[size];
+                        E** elements = new E*[size];
+                        K* keys = new K[size];
+                        std::memcpy(codes, _codes, _count * sizeof(Code));
+                        std::memcpy(elements, _elements, _count * sizeof(E*));
+                        std::memcpy(keys, _keys, _count * sizeof(K));
+                        delete []_codes;
+                        delete []_elements;
+                        delete []_keys;
+                        _codes = codes;
+                        _elements = elements;
+                        _keys = keys;
+                        _capacity = size;
+                        // Reallocated, at the new size, by the next sort.
+                        delete []_spare;
+                        delete []_spareElements;
+                        delete []_spareKeys;
+                        _spare = nullptr;
+                        _spareElements = nullptr;
+                        _spareKeys = nullptr;
+                    }
+                }
+
+            template <typename K, typename R, typename E>
+                void MortonTree<K, R, E>::shift(unsigned int target, unsigned int source, unsigned int count) {
+                    std::memmove(_codes + target, _codes + source, count * sizeof(Code));
+                    std::memmove(_elements + target, _elements + source, count * sizeof(E*));
+                    std::memmove(_keys + target, _keys + source, count * sizeof(K));
+                }
+
+            template <typename K, typename R, typename E>
+                void MortonTree<K, R, E>::settle() {
+                    for(unsigned int i = 1; i < _count; ++i) {
+                        Code code = _codes[i];
+                        if(code < _codes[i - 1]) {
+                            E* element = _elements[i];
+                            K key = _keys[i];
+                            unsigned int j = i;
+                            do {
+                                _codes[j] = _codes[j - 1];
+                                _elements[j] = _elements[j - 1];
+                                _keys[j] = _keys[j - 1];
+                                --j;
+                            } while(j > 0 && _codes[j - 1] > code);
+                            _codes[j] = code;
+                            _elements[j] = element;
+                            _keys[j] = key;
+                        }
+                    }
+                }
+
+            template <typename K, typename R, typename E>
+                void MortonTree<K, R, E>::sort() {
+                    // LSD radix sort, with as few passes of at most MORTON_RADIX_BITS
+                    // bits as codes (up to '_span' included) need.
+                    unsigned int bits = 0;
+                    while(bits < 64 && 0 != (_span >> bits)) {
+                        ++bits;
+                    }
+                    unsigned int passes = (bits + MORTON_RADIX_BITS - 1) / MORTON_RADIX_BITS;
+                    unsigned int width = (bits + passes - 1) / passes;
+                    Code digit = (Code(1) << width) - 1;
+                    if(nullptr == _spare) {
+                        _spare = new Code[_capacity];
+                        _spareElements = new E*[_capacity];
+                        _spareKeys = new K[_capacity];
+                    }
+                    unsigned int offsets[(1 << MORTON_RADIX_BITS) + 1];
+                    for(unsigned int pass = 0; pass < passes; ++pass) {
+                        unsigned int shift = pass * width;
+                        std::memset(offsets, 0, (digit + 2) * sizeof(unsigned int));
+                        for(unsigned int i = 0; i < _count; ++i) {
+                            ++offsets[((_codes[i] >> shift) & digit) + 1];
+                        }
+                        for(unsigned int i = 1; i <= digit; ++i) {
+                            offsets[i] += offsets[i - 1];
+                        }
+                        for(unsigned int i = 0; i < _count; ++i) {
+                            unsigned int target = offsets[(_codes[i] >> shift) & digit]++;
+                            _spare[target] = _codes[i];
+                            _spareElements[target] = _elements[i];
+                            _spareKeys[target] = _keys[i];
+                        }
+                        std::swap(_spare, _codes);
+                        std::swap(_spareElements, _elements);
+                        std::swap(_spareKeys, _keys);
+                    }
+                }
+
+            template <typename K, typename R, typename E>
+                bool MortonTree<K, R, E>::add(E* element) {
+                    const K& key = element->key();
+                    bool result = _region.contains(key);
+                    if(result) {
+                        Code code = encode(key);
+                        reserve(_count + 1);
+                        unsigned int target = upper(0, _count, code);
+                        shift(target + 1, target, _count - target);
+                        _codes[target] = code;
+                        _elements[target] = element;
+                        _keys[target] = key;
+                        ++_count;
+                    }
+                    return result;
+                }
+
+            template <typename K, typename R, typename E>
+                void MortonTree<K, R, E>::remove(E* element) {
+                    unsigned int source = position(element);
+                    if(source < _count) {
+                        --_count;
+                        shift(source, source + 1, _count - source);
+                    }
+                }
+
+            template <typename K, typename R, typename E>
+                void MortonTree<K, R, E>::move(E* element, K& key) {
+                    unsigned int source = position(element);
+                    element->key(key);
+                    if(source == _count) {
+                        add(element);
+                    } else if(!_region.contains(key)) {
+                        --_count;
+                        shift(source, source + 1, _count - source);
+                    } else {
+                        Code code = encode(key);
+                        unsigned int target;
+                        if(code >= _codes[source]) {
+                            target = upper(source + 1, _count, code) - 1;
+                            shift(source, source + 1, target - source);
+                        } else {
+                            target = upper(0, source, code);
+                            shift(target + 1, target, source - target);
+                        }
+                        _codes[target] = code;
+                        _elements[target] = element;
+                        _keys[target] = key;
+                    }
+                }
+
+            template <typename K, typename R, typename E>
+                void MortonTree<K, R, E>::moveAll(E** elements, K* keys, unsigned int count) {
+                    // Locate the elements while the codes are still sorted.
+                    unsigned int* positions = new unsigned int[count];
+                    for(unsigned int i = 0; i < count; ++i) {
+                        positions[i] = position(elements[i]);
+                    }
+                    // Elements leaving the region get a code past any valid one.
+                    const Code out = _span;
+                    unsigned int changed = 0;
+                    unsigned int leaving = 0;
+                    for(unsigned int i = 0; i < count; ++i) {
+                        unsigned int pos = positions[i];
+                        if(pos < _count) {
+                            Code code = _region.contains(keys[i]) ? encode(keys[i]) : out;
+                            if(code != _codes[pos]) {
+                                _codes[pos] = code;
+                                ++changed;
+                                if(code == out) {
+                                    ++leaving;
+                                }
+                            }
+                            _keys[pos] = keys[i];
+                        }
+                        elements[i]->key(keys[i]);
+                    }
+                    // Few changes are merged in place, otherwise sort again.
+                    if(changed > _count / 16) {
+                        sort();
+                    } else if(changed > 0) {
+                        settle();
+                    }
+                    _count -= leaving;
+                    // Elements that were not stored are added as 'move' does.
+                    for(unsigned int i = 0; i < count; ++i) {
+                        if(positions[i] == _count + leaving) {
+                            add(elements[i]);
+                        }
+                    }
+                    delete []positions;
+                }
+
+            template <typename K, typename R, typename E>
+                void MortonTree<K, R, E>::build(E** elements, unsigned int count) {
+                    reserve(count);
+                    _count = 0;
+                    for(unsigned int i = 0; i < count; ++i) {
+                        const K& key = elements[i]->key();
+                        if(_region.contains(key)) {
+                            _codes[_count] = encode(key);
+                            _elements[_count] = elements[i];
+                            _keys[_count] = key;
+                            ++_count;
+                        }
+                    }
+                    sort();
+                }
+
+            template <typename K, typename R, typename E>
+                template <typename S, typename V>
+                unsigned int MortonTree<K, R, E>::retrieve(const S& func, E** buffer, unsigned int size,
+                        V* visitor, bool* overflow) const {
+                    Collector<E> collector(buffer, size);
+                    retrieve(func, collector, visitor);
+                    if(nullptr != overflow) {
+                        *overflow = collector.overflow();
+                    }
+                    return collector.count();
+                }
+
+            template <typename K, typename R, typename E>
+                template <typename S, typename C, typename V>
+                bool MortonTree<K, R, E>::retrieve(const S& func, C& sink, V* visitor) const {
+                    return retrieve(_region, _span, 0, 0, _count, func, sink, visitor);
+                }
+
+            template <typename K, typename R, typename E>
+                template <typename Q, typename C>
+                void MortonTree<K, R, E>::retrieveAll(const Q& queries, unsigned int count,
+                        unsigned int size, C& consumer) const {
+                    #pragma omp parallel
+                    {
+                        E** buffer = new E*[size];
+                        #pragma omp for schedule(dynamic, BATCH_CHUNK_SIZE)
+                        for(unsigned int i = 0; i < count; ++i) {
+                            unsigned int retrieved = retrieve(queries(i), buffer, size);
+                            consumer(i, buffer, retrieved);
+                        }
+                        delete []buffer;
+                    }
+                }
+
+            template <typename K, typename R, typename E>
+                template <typename S, typename C, typename V>
+                bool MortonTree<K, R, E>::retrieve(const R& region, Code span, Code first,
+                        unsigned int begin, unsigned int end, const S& func, C& sink, V* visitor) const {
+                    bool result = true;
+                    if(nullptr != visitor) {
+                        visitor->enter(region);
+                    }
+                    if(1 == span || end - begin <= _cardinality) {
+                        // Implicit leaf.
+                        result = scan(begin, end, func, sink, visitor,
+                                std::integral_constant<bool, Batched<S, K>::value>());
+                    } else {
+                        R regions[Fanout<R>::value];
+                        region.divide(regions);
+                        Code sub = span / Fanout<R>::value;
+                        for(unsigned int i = 0; i < Fanout<R>::value && result; ++i) {
+                            unsigned int last = (i + 1 < Fanout<R>::value) ?
+                                lower(begin, end, first + (i + 1) * sub) : end;
+                            if(begin < last) {
+                                int intersects = func.contains(regions[i]);
+                                if(intersects > 0) {
+                                    result = fetch(regions[i], begin, last, sink, visitor);
+                                } else if(intersects == 0) {
+                                    result = retrieve(regions[i], sub, first + i * sub, begin, last,
+                                            func, sink, visitor);
+                                }
+                            }
+                            begin = last;
+                        }
+                    }
+                    if(nullptr != visitor) {
+                        visitor->exit(region);
+                    }
+                    return result;
+                }
+
+            template <typename K, typename R, typename E>
+                template <typename C, typename V>
+                bool MortonTree<K, R, E>::fetch(const R& region, unsigned int begin, unsigned int end,
+                        C& sink, V* visitor) const {
+                    bool result = true;
+                    if(nullptr != visitor) {
+                        visitor->enter(region);
+                        visitor->inspect(_elements + begin, end - begin);
+                    }
+                    for(unsigned int i = begin; i < end && result; ++i) {
+                        result = sink(_elements[i]);
+                    }
+                    if(nullptr != visitor) {
+                        visitor->exit(region);
+                    }
+                    return result;
+                }
+
+            template <typename K, typename R, typename E>
+                template <typename S, typename C, typename V>
+                bool MortonTree<K, R, E>::scan(unsigned int begin, unsigned int end, const S& func,
+                        C& sink, V* visitor, std::false_type) const {
+                    bool result = true;
+                    for(unsigned int i = begin; i < end && result; ++i) {
+                        if(func.contains(_keys[i])) {
+                            if(nullptr != visitor) {
+                                visitor->inspect(_elements[i]);
+                            }
+                            result = sink(_elements[i]);
+                        }
+                    }
+                    return result;
+                }
+
+            template <typename K, typename R, typename E>
+                template <typename S, typename C, typename V>
+                bool MortonTree<K, R, E>::scan(unsigned int begin, unsigned int end, const S& func,
+                        C& sink, V* visitor, std::true_type) const {
+                    bool result = true;
+                    unsigned char mask[SCAN_BLOCK_SIZE];
+                    for(unsigned int start = begin; start < end && result; start += SCAN_BLOCK_SIZE) {
+                        unsigned int block = end - start < SCAN_BLOCK_SIZE ? end - start : SCAN_BLOCK_SIZE;
+                        func.contains(_keys + start, block, mask);
+                        for(unsigned int i = 0; i < block && result; ++i) {
+                            if(0 != mask[i]) {
+                                E* element = _elements[start + i];
+                                if(nullptr != visitor) {
+                                    visitor->inspect(element);
+                                }
+                                result = sink(element);
+                            }
+                        }
+                    }
+                    return result;
+                }
+
+            template <typename K, typename R, typename E>
+                template <typename V>
+                void MortonTree<K, R, E>::visit(V& visitor) {
+                    visit(_region, _span, 0, 0, _count, visitor);
+                }
+
+            template <typename K, typename R, typename E>
+                template <typename V>
+                void MortonTree<K, R, E>::visit(const R& region, Code span, Code first,
+                        unsigned int begin, unsigned int end, V& visitor) {
+                    visitor.enter(region);
+                    if(1 == span || end - begin <= _cardinality) {
+                        visitor.inspect(_elements + begin, end - begin);
+                    } else {
+                        R regions[Fanout<R>::value];
+                        region.divide(regions);
+                        Code sub = span / Fanout<R>::value;
+                        for(unsigned int i = 0; i < Fanout<R>::value; ++i) {
+                            unsigned int last = (i + 1 < Fanout<R>::value) ?
+                                lower(begin, end, first + (i + 1) * sub) : end;
+                            visit(regions[i], sub, first + i * sub, begin, last, visitor);
+                            begin = last;
+                        }
+                    }
+                    visitor.exit(region);
+                }
+
+        } // Namespace 'SearchTree'
+    } // Namespace 'Logic'
+} // Namespace 'Headless'
+
+#endif
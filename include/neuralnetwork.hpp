@@ -16,21 +16,172 @@
 #ifndef HEADLESS_LOGIC_NEURAL_NETWORK
 #define HEADLESS_LOGIC_NEURAL_NETWORK
 
+#include <algorithm>
+#include <cstdint>
 #include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * Alignment of weight rows, in bytes.
+ */
+#define NN_ALIGNMENT 64
+/**
+ * Number of weight rows computed together.
+ */
+#define NN_ROW_BLOCK 4
+/**
+ * Number of weights from which a step is spread over threads.
+ */
+#define NN_PARALLEL_THRESHOLD 65536
+/**
+ * Number of networks computed together by a batched step.
+ */
+#define NN_LANE_BLOCK 256
 
 namespace Headless {
     namespace Logic {
         namespace NeuralNet {
 
+            /**
+             * Tell if an activation function applies to a whole layer at once, i.e.
+             * if it implements 'void apply(T* values, unsigned int count) const',
+             * replacing each biased neuron input by its activation.
+             * @param <F> Activation function concept.
+             * @param <T> Precision.
+             */
+            template <typename F, typename T> class Vectorized {
+                private:
+                    template <typename U> static char test(
+                            decltype(std::declval<const U&>().apply(std::declval<T*>(), 0u))*);
+                    template <typename U> static long test(...);
+                public:
+                    static const bool value = sizeof(test<F>(nullptr)) == sizeof(char);
+            };
+
+            /**
+             * Activation dispatch. Per-neuron functions are called as each neuron
+             * input is computed. 'Vectorized' functions are given the biased
+             * inputs of a layer once it is computed, and can be inlined and
+             * vectorized over it.
+             * @param <F> Activation function concept.
+             * @param <T> Precision.
+             */
+            template <typename F, typename T> class Activation {
+                public:
+                    typedef std::integral_constant<bool, Vectorized<F, T>::value> Tag;
+
+                    /**
+                     * @return Neuron output, or biased input if vectorized.
+                     */
+                    static T neuron(F* function, T value, T bias) {
+                        return neuron(function, value, bias, Tag());
+                    }
+
+                    /**
+                     * Activate a layer of biased inputs if vectorized.
+                     */
+                    static void layer(F* function, T* values, unsigned int count) {
+                        layer(function, values, count, Tag());
+                    }
+
+                private:
+                    static T neuron(F* function, T value, T bias, std::false_type) {
+                        return function->compute(value, bias);
+                    }
+                    static T neuron(F*, T value, T bias, std::true_type) {
+                        return value + bias;
+                    }
+                    static void layer(F*, T*, unsigned int, std::false_type) {}
+                    static void layer(F* function, T* values, unsigned int count, std::true_type) {
+                        function->apply(values, count);
+                    }
+            };
+
+            /**
+             * Rational approximation of the hyperbolic tangent, vectorizable.
+             * Absolute error is below 1e-4.
+             * @param <T> Precision.
+             */
+            template <typename T> inline T fastTanh(T x) {
+                // Lambert continued fraction, clamped where it crosses 1.
+                x = x < T(-4.97) ? T(-4.97) : (x > T(4.97) ? T(4.97) : x);
+                T x2 = x * x;
+                return x * (T(135135) + x2 * (T(17325) + x2 * (T(378) + x2)))
+                    / (T(135135) + x2 * (T(62370) + x2 * (T(3150) + x2 * T(28))));
+            }
+
+            /**
+             * Logistic activation, using the 'fastTanh' approximation.
+             * @param <T> Precision.
+             */
+            template <typename T> class Sigmoid {
+                public:
+                    T compute(T inValue, T bias) const {
+                        return T(0.5) + T(0.5) * fastTanh(T(0.5) * (inValue + bias));
+                    }
+                    void apply(T* values, unsigned int count) const {
+                        #pragma omp simd
+                        for(unsigned int i = 0; i < count; ++i) {
+                            values[i] = T(0.5) + T(0.5) * fastTanh(T(0.5) * values[i]);
+                        }
+                    }
+            };
+
+            /**
+             * Hyperbolic tangent activation, using the 'fastTanh' approximation.
+             * @param <T> Precision.
+             */
+            template <typename T> class Tanh {
+                public:
+                    T compute(T inValue, T bias) const {
+                        return fastTanh(inValue + bias);
+                    }
+                    void apply(T* values, unsigned int count) const {
+                        #pragma omp simd
+                        for(unsigned int i = 0; i < count; ++i) {
+                            values[i] = fastTanh(values[i]);
+                        }
+                    }
+            };
+
+            /**
+             * Rectified linear activation.
+             * @param <T> Precision.
+             */
+            template <typename T> class ReLU {
+                public:
+                    T compute(T inValue, T bias) const {
+                        T value = inValue + bias;
+                        return value > T(0) ? value : T(0);
+                    }
+                    void apply(T* values, unsigned int count) const {
+                        #pragma omp simd
+                        for(unsigned int i = 0; i < count; ++i) {
+                            values[i] = values[i] > T(0) ? values[i] : T(0);
+                        }
+                    }
+            };
 
             /**
              * Trivial mono-layer recursive neural-net.
              * (Input(t), Output(t), Intermediate(t)) -> F -> (Output(t+1), Intermediate(t+1))
+             *
+             * Each step is one matrix-vector product between the weights and the
+             * concatenated signals, followed by the activation. Weight rows are
+             * padded to NN_ALIGNMENT bytes so that each row starts aligned, and
+             * rows are processed NN_ROW_BLOCK at a time so the signals loaded for
+             * one row are reused by the next ones. Rows are spread over OpenMP
+             * threads only when there are at least NN_PARALLEL_THRESHOLD weights,
+             * smaller networks being faster on one thread. Build with '-fopenmp',
+             * or at least '-fopenmp-simd', for the row loops to be vectorized.
+             * @param <T> Precision, 'float' or 'double'. Defaults to 'double'.
              */
-            template class TrivialMonoRecursive {
+            template <typename T = double> class TrivialMonoRecursive {
                 public:
                     /**
-                     * Constructor.
+                     * Constructor. Weights and biases are zeroed.
                      * @param input Number of input signals.
                      * @param output Number of output signals.
                      * @param intermediate Number of intermediate neurons.
@@ -48,34 +199,78 @@ namespace Headless {
                      * @param output Result vector (containing numbers in [0;1])
                      * @param function Activation function.
                      * @param <F> Activation function type. It must implement the following:
-                     *      double compute(double inValue, double bias);
+                     *      T compute(T inValue, T bias);
+                     *      or be 'Vectorized'.
+                     */
+                    template <typename F> void compute(const T *input, T *output, F *function);
+
+                    /**
+                     * Weights, one row per neuron. The weight given by neuron 'i'
+                     * to signal 'j' is at 'i * stride() + j'. Signals are the input
+                     * signals followed by the output and intermediate neurons.
+                     * Padding weights, from 'signals()' to 'stride()', must stay null.
+                     */
+                    T *weights() { return _weight; }
+
+                    T *biases() { return _bias; }
+
+                    /**
+                     * @return Number of signals fed to each neuron.
                      */
-                    template <F> void compute(double *input, double *output, F *function);
+                    unsigned int signals() const { return _inCount + _outCount + _mediumCount; }
 
-                    double *weights() { return _weight; }
+                    /**
+                     * @return Number of neurons.
+                     */
+                    unsigned int neurons() const { return _outCount + _mediumCount; }
 
-                    double *biases() { return _bias; }
+                    /**
+                     * @return Distance between two weight rows.
+                     */
+                    unsigned int stride() const { return _stride; }
+
+                    /**
+                     * Reset the neurons state.
+                     */
+                    void reset();
+
+                private:
+                    TrivialMonoRecursive(const TrivialMonoRecursive&) = delete;
+                    TrivialMonoRecursive& operator=(const TrivialMonoRecursive&) = delete;
+
+                    /**
+                     * Compute a block of rows.
+                     * @param row First row.
+                     * @param count Number of rows, at most NN_ROW_BLOCK.
+                     * @param function Activation function.
+                     */
+                    template <typename F> void block(unsigned int row, unsigned int count, F *function);
 
                 private:
                     /**
-                     * Input signals.
+                     * Input signals, aligned and padded to the stride.
                      */
-                    double *_input;
+                    T *_input;
 
                     /**
                      * Output signals.
                      */
-                    double *_output;
+                    T *_output;
 
                     /**
-                     * Weights.
+                     * Weights, aligned.
                      */
-                    double *_weight;
+                    T *_weight;
 
                     /**
                      * Biases.
                      */
-                    double *_bias;
+                    T *_bias;
+
+                    /**
+                     * Raw memory of the aligned buffers.
+                     */
+                    void *_memory;
 
                     /**
                      * Input signal count.
@@ -91,108 +286,255 @@ namespace Headless {
                      * Intermediate neurons count.
                      */
                     unsigned int _mediumCount;
+
+                    /**
+                     * Weight row length, padding included.
+                     */
+                    unsigned int _stride;
             };
 
+            template <typename T>
+                TrivialMonoRecursive<T>::TrivialMonoRecursive(
+                        unsigned int input, unsigned int output, unsigned int intermediate) :
+                    _output(new T[output + intermediate]),
+                    _bias(new T[output + intermediate]),
+                    _inCount(input), _outCount(output), _mediumCount(intermediate) {
+                        const unsigned int lane = NN_ALIGNMENT / sizeof(T);
+                        const unsigned int inSize = input + output + intermediate;
+                        const unsigned int size = output + intermediate;
+                        _stride = ((inSize + lane - 1) / lane) * lane;
+                        // Input row followed by the weight rows, all of them aligned.
+                        const std::size_t count = static_cast<std::size_t>(_stride) * (size + 1);
+                        _memory = ::operator new(count * sizeof(T) + NN_ALIGNMENT);
+                        std::uintptr_t address = reinterpret_cast<std::uintptr_t>(_memory);
+                        address = (address + NN_ALIGNMENT - 1) & ~static_cast<std::uintptr_t>(NN_ALIGNMENT - 1);
+                        _input = reinterpret_cast<T*>(address);
+                        _weight = _input + _stride;
+                        std::fill(_input, _input + count, T(0));
+                        std::fill(_bias, _bias + size, T(0));
+                        std::fill(_output, _output + size, T(0));
+                    }
 
-            TrivialMonoRecursive::TrivialMonoRecursive(
-                    unsigned int input, unsigned int output, unsigned int intermediate) :
-                _input(new double[input + output + intermediate]),
-                _output(new double[output + intermediate]),
-                _weight(new double[(input + output + intermediate) * (output + intermediate)]),
-                _biases(new double[output + intermediate]),
-                _inCount(input), _outCount(output), _mediumCount(intermediate) {
+            template <typename T>
+                TrivialMonoRecursive<T>::~TrivialMonoRecursive() {
+                    ::operator delete(_memory);
+                    delete[] _output;
+                    delete[] _bias;
                 }
 
-            TrivialMonoRecursive::~TrivialMonoRecursive() {
-                delete[] _input;
-                delete[] _output;
-                delete[] _weigth;
-                delete[] _bias;
-            }
+            template <typename T>
+                void TrivialMonoRecursive<T>::reset() {
+                    std::fill(_output, _output + _outCount + _mediumCount, T(0));
+                }
 
-            template <typename F>
-                void TrivialMonoRecursive::compute(double* inSig, double* outSig, F* function) {
-                    memcpy(_input, inSig, _inCount);
+            template <typename T>
+                template <typename F>
+                void TrivialMonoRecursive<T>::compute(const T* inSig, T* outSig, F* function) {
                     const unsigned int size = _outCount + _mediumCount;
-                    const unsigned int inSize = _inCount + size;
-                    memcpy(_input + _inCount, _output, size);
-#pragma openmp parallel for
-                    for(unsigned int i = 0; i < size; ++i) {
-                        double inValue = 0;
-                        double *inW = _weigth + (i * inSize);
-                        for(unsigned int j = 0; j < inSize; ++j) {
-                            inValue += _input[j] * inW[j];
-                        }
-                        _output[i] = function->compute(inValue, _bias[i]);
-                    }
-                    memcpy(outSig, _output, _outCount);
+                    std::memcpy(_input, inSig, _inCount * sizeof(T));
+                    std::memcpy(_input + _inCount, _output, size * sizeof(T));
+                    const unsigned int blocks = (size + NN_ROW_BLOCK - 1) / NN_ROW_BLOCK;
+                    if(static_cast<std::size_t>(size) * _stride >= NN_PARALLEL_THRESHOLD) {
+                        #pragma omp parallel for
+                        for(unsigned int b = 0; b < blocks; ++b) {
+                            const unsigned int row = b * NN_ROW_BLOCK;
+                            block(row, size - row < NN_ROW_BLOCK ? size - row : NN_ROW_BLOCK, function);
+                        }
+                    } else {
+                        // Even a serialized parallel region costs more than a
+                        // small step.
+                        for(unsigned int b = 0; b < blocks; ++b) {
+                            const unsigned int row = b * NN_ROW_BLOCK;
+                            block(row, size - row < NN_ROW_BLOCK ? size - row : NN_ROW_BLOCK, function);
+                        }
+                    }
+                    Activation<F, T>::layer(function, _output, size);
+                    std::memcpy(outSig, _output, _outCount * sizeof(T));
+                }
+
+            template <typename T>
+                template <typename F>
+                void TrivialMonoRecursive<T>::block(unsigned int row, unsigned int count, F* function) {
+                    const T* in = _input;
+                    const unsigned int stride = _stride;
+                    if(count == NN_ROW_BLOCK) {
+                        const T* w0 = _weight + static_cast<std::size_t>(row) * stride;
+                        const T* w1 = w0 + stride;
+                        const T* w2 = w1 + stride;
+                        const T* w3 = w2 + stride;
+                        T s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+                        // Padding is null: the whole aligned row can be walked.
+                        #pragma omp simd reduction(+:s0,s1,s2,s3) aligned(in,w0,w1,w2,w3:NN_ALIGNMENT)
+                        for(unsigned int j = 0; j < stride; ++j) {
+                            s0 += in[j] * w0[j];
+                            s1 += in[j] * w1[j];
+                            s2 += in[j] * w2[j];
+                            s3 += in[j] * w3[j];
+                        }
+                        _output[row] = Activation<F, T>::neuron(function, s0, _bias[row]);
+                        _output[row + 1] = Activation<F, T>::neuron(function, s1, _bias[row + 1]);
+                        _output[row + 2] = Activation<F, T>::neuron(function, s2, _bias[row + 2]);
+                        _output[row + 3] = Activation<F, T>::neuron(function, s3, _bias[row + 3]);
+                    } else {
+                        for(unsigned int i = row; i < row + count; ++i) {
+                            const T* w = _weight + static_cast<std::size_t>(i) * stride;
+                            T sum = 0;
+                            #pragma omp simd reduction(+:sum) aligned(in,w:NN_ALIGNMENT)
+                            for(unsigned int j = 0; j < stride; ++j) {
+                                sum += in[j] * w[j];
+                            }
+                            _output[i] = Activation<F, T>::neuron(function, sum, _bias[i]);
+                        }
+                    }
                 }
 
             /**
-             * Simple Mono-Layer Recursive Neural-Net.
-             * Implementation of the core-engine of a lifetime
-             * home-brew neural net scheme.
-             * (Input(t), Output(t), Intermediate(t)) -> F -> (Output(t+1), Intermediate(t+1))
-             * @param <F> The activation function. There's only
-             *    one per neural-net in this case.
-             *    An activation function must define the following:
-             *      F(neuronId, inputSignalCount, args...)
-             *      double compute(double *);
+             * Batch of trivial mono-layer recursive neural-nets sharing one topology.
+             * Stepping many tiny networks one by one is dominated by overhead: a
+             * batch steps them all at once, e.g. one network per agent of a crowd.
+             *
+             * Signals and states are stored network-minor ('structure of arrays'):
+             * signal 'j' of all networks is one aligned row. With shared weights,
+             * a step is a single matrix-matrix product between the weights and the
+             * signals. With per-network weights, networks are stepped in lockstep,
+             * and the weights of each SIMD width of networks are stored together,
+             * so that they are read in one stream. Either way, the
+             * innermost loop runs across networks and is vectorized. The batch is
+             * cut in tiles of NN_ROW_BLOCK neurons by NN_LANE_BLOCK networks that
+             * fit in cache, spread over OpenMP threads past NN_PARALLEL_THRESHOLD
+             * multiply-adds per step.
+             * Shared weights are read once per step for the whole batch, which is
+             * where batching pays off most. Per-network weights are each used once
+             * per step, so that step is bound by the memory bandwidth: it is on par
+             * with or faster than stepping as many networks one by one, but slower
+             * than stepping one network whose weights stay in cache.
+             * @param <T> Precision, 'float' or 'double'. Defaults to 'double'.
              */
-            template <typename F> class MonoRecursive {
+            template <typename T = double> class BatchedMonoRecursive {
                 public:
                     /**
-                     * Constructor.
+                     * Constructor. Weights, biases and states are zeroed.
+                     * @param count Number of networks.
                      * @param input Number of input signals.
                      * @param output Number of output signals.
                      * @param intermediate Number of intermediate neurons.
-                     * @þaram <A...> List of arguments type for neurons initialisation.
-                     * @param args... Arguments list for neuron initialisation.
+                     * @param shared If set, all networks share the same weights and biases.
                      */
-                    template<typename A...>
-                        MonoRecursive(unsigned int input, unsigned int output, unsigned int intermediate
-                                A args...);
+                    BatchedMonoRecursive(unsigned int count, unsigned int input, unsigned int output,
+                            unsigned int intermediate, bool shared = true);
 
                     /**
                      * Destructor.
                      */
-                    ~MonoRecursive();
+                    ~BatchedMonoRecursive();
 
                     /**
-                     * Retrieve a neuron.
-                     * @param index Index of the neuron to retrieve.
-                     * @return The neuron.
+                     * Set the weights and biases of all networks.
+                     * @param weights Weights, one row per neuron, as in 'TrivialMonoRecursive'.
+                     * @param stride Distance between two weight rows, at least 'signals()'.
+                     * @param biases Biases, one per neuron.
                      */
-                    F* operator[](unsigned int index) {
-                        F* result = nullptr;
-                        if(index < (output + intermediate)) {
-                            result = _layer[i];
-                        }
-                        return result;
-                    }
+                    void load(const T* weights, unsigned int stride, const T* biases);
 
                     /**
-                     * Perform one computation step.
-                     * @param input Input vector (containing numbers in [0;1])
-                     * @param output Result vector (containing numbers in [0;1])
+                     * Set the weights and biases of one network. Weights must not be shared.
+                     * @param network Network index.
+                     * @param weights Weights, one row per neuron, as in 'TrivialMonoRecursive'.
+                     * @param stride Distance between two weight rows, at least 'signals()'.
+                     * @param biases Biases, one per neuron.
+                     */
+                    void load(unsigned int network, const T* weights, unsigned int stride, const T* biases);
+
+                    /**
+                     * Perform one computation step of all networks.
+                     * @param input Input vectors, network after network (containing numbers in [0;1]).
+                     * @param output Result vectors, network after network (containing numbers in [0;1]).
+                     * @param function Activation function. See 'TrivialMonoRecursive'.
+                     */
+                    template <typename F> void compute(const T *input, T *output, F *function);
+
+                    /**
+                     * Reset the neurons state of all networks.
+                     */
+                    void reset();
+
+                    /**
+                     * Reset the neurons state of one network.
+                     * @param network Network index.
+                     */
+                    void reset(unsigned int network);
+
+                    /**
+                     * @return Number of networks.
+                     */
+                    unsigned int count() const { return _count; }
+
+                    /**
+                     * @return Number of signals fed to each neuron.
+                     */
+                    unsigned int signals() const { return _inCount + _outCount + _mediumCount; }
+
+                    /**
+                     * @return Number of neurons of each network.
                      */
-                    void compute(double *input, double *output);
+                    unsigned int neurons() const { return _outCount + _mediumCount; }
+
+                    /**
+                     * @return true if weights and biases are shared.
+                     */
+                    bool shared() const { return _shared; }
+
+                private:
+                    BatchedMonoRecursive(const BatchedMonoRecursive&) = delete;
+                    BatchedMonoRecursive& operator=(const BatchedMonoRecursive&) = delete;
+
+                    /**
+                     * Compute a tile.
+                     * @param row First neuron.
+                     * @param rows Number of neurons.
+                     * @param lane First network.
+                     * @param width Number of networks, a multiple of the SIMD width.
+                     * @param function Activation function.
+                     */
+                    template <typename F> void tile(unsigned int row, unsigned int rows,
+                            unsigned int lane, unsigned int width, F *function);
 
                 private:
                     /**
-                     * Input array.
+                     * Signals, one row of '_lanes' per signal.
                      */
-                    double *_input;
+                    T *_signal;
 
                     /**
-                     * Output array.
+                     * Neurons state, one row of '_lanes' per neuron.
                      */
-                    double *_output;
+                    T *_state;
 
                     /**
-                     * Activation function layer.
+                     * Weights, either one matrix or, per SIMD width of networks, one
+                     * matrix of SIMD width wide weights.
                      */
-                    F **_layer;
+                    T *_weight;
+
+                    /**
+                     * Biases, either one per neuron or one row of '_lanes' per neuron.
+                     */
+                    T *_bias;
+
+                    /**
+                     * Raw memory of the aligned buffers.
+                     */
+                    void *_memory;
+
+                    /**
+                     * Network count.
+                     */
+                    unsigned int _count;
+
+                    /**
+                     * Row length, network count rounded up to the SIMD width.
+                     */
+                    unsigned int _lanes;
 
                     /**
                      * Input signal count.
@@ -208,46 +550,279 @@ namespace Headless {
                      * Intermediate neurons count.
                      */
                     unsigned int _mediumCount;
+
+                    /**
+                     * Shared weights flag.
+                     */
+                    bool _shared;
             };
 
-            template <typename F>
-                template <typename A...>
-                MonoRecursive<F>::MonoRecursive(
-                        unsigned int input, unsigned int output, unsigned int intermediate,
-                        A args...) :
-                    _input(new double[input + output + intermediate]),
-                    _output(new double[output + intermediate]),
-                    _layer(new F*[output + intermediate]),
-                    _inCount(input), _outCount(output), _mediumCount(intermediate) {
-                        unsigned int size = output + intermediate;
-                        for(unsigned int i = 0; i < size; ++i) {
-                            _layer[i] = new F(i, input + output + intermediate, args...);
+            template <typename T>
+                BatchedMonoRecursive<T>::BatchedMonoRecursive(unsigned int count,
+                        unsigned int input, unsigned int output, unsigned int intermediate, bool shared) :
+                    _count(count), _inCount(input), _outCount(output), _mediumCount(intermediate),
+                    _shared(shared) {
+                        const std::size_t lane = NN_ALIGNMENT / sizeof(T);
+                        const std::size_t signals = input + output + intermediate;
+                        const std::size_t neurons = output + intermediate;
+                        _lanes = static_cast<unsigned int>(((count + lane - 1) / lane) * lane);
+                        // Every buffer is rounded up to the SIMD width to stay aligned.
+                        const std::size_t weights = shared ?
+                            ((neurons * signals + lane - 1) / lane) * lane : neurons * signals * _lanes;
+                        const std::size_t biases = shared ? neurons : neurons * _lanes;
+                        const std::size_t size = (signals + neurons) * _lanes + weights + biases;
+                        _memory = ::operator new(size * sizeof(T) + NN_ALIGNMENT);
+                        std::uintptr_t address = reinterpret_cast<std::uintptr_t>(_memory);
+                        address = (address + NN_ALIGNMENT - 1) & ~static_cast<std::uintptr_t>(NN_ALIGNMENT - 1);
+                        _signal = reinterpret_cast<T*>(address);
+                        _state = _signal + signals * _lanes;
+                        _weight = _state + neurons * _lanes;
+                        _bias = _weight + weights;
+                        std::fill(_signal, _signal + size, T(0));
+                    }
+
+            template <typename T>
+                BatchedMonoRecursive<T>::~BatchedMonoRecursive() {
+                    ::operator delete(_memory);
+                }
+
+            template <typename T>
+                void BatchedMonoRecursive<T>::load(const T* weights, unsigned int stride, const T* biases) {
+                    const unsigned int signals = this->signals();
+                    const unsigned int neurons = this->neurons();
+                    if(_shared) {
+                        for(unsigned int i = 0; i < neurons; ++i) {
+                            std::memcpy(_weight + i * signals, weights + static_cast<std::size_t>(i) * stride,
+                                    signals * sizeof(T));
+                        }
+                        std::memcpy(_bias, biases, neurons * sizeof(T));
+                    } else {
+                        for(unsigned int b = 0; b < _count; ++b) {
+                            load(b, weights, stride, biases);
                         }
                     }
+                }
 
-            template <typename F>
-                void MonoRecursive<F>::compute(double *input, double *output) {
-                    memcpy(_input, input, _inCount);
-                    unsigned int size = _outCount + _mediumCount;
-                    memcpy(_input + _inCount, _output, size);
-#pragma openmp parallel for
-                    for(unsigned int i = 0; i < size; ++i) {
-                        _output[i] = _layer[i]->compute(_input);
+            template <typename T>
+                void BatchedMonoRecursive<T>::load(unsigned int network, const T* weights,
+                        unsigned int stride, const T* biases) {
+                    const unsigned int signals = this->signals();
+                    const unsigned int neurons = this->neurons();
+                    const unsigned int chunk = NN_ALIGNMENT / sizeof(T);
+                    T* block = _weight + static_cast<std::size_t>(network / chunk) * neurons * signals * chunk
+                        + network % chunk;
+                    for(unsigned int i = 0; i < neurons; ++i) {
+                        T* row = block + static_cast<std::size_t>(i) * signals * chunk;
+                        for(unsigned int j = 0; j < signals; ++j) {
+                            row[static_cast<std::size_t>(j) * chunk] = weights[static_cast<std::size_t>(i) * stride + j];
+                        }
+                        _bias[static_cast<std::size_t>(i) * _lanes + network] = biases[i];
                     }
-                    memcpy(output, _output, _outCount);
                 }
 
-            template <typename F>
-                MonoRecursive<F>::~MonoRecursive() {
-                    delete[] _input;
-                    delete[] _output;
-                    unsigned int size = _outCount + _mediumCount;
-                    for(unsigned int i = 0; i < size; ++i) {
-                        delete _layer[i];
+            template <typename T>
+                void BatchedMonoRecursive<T>::reset() {
+                    std::fill(_state, _state + static_cast<std::size_t>(neurons()) * _lanes, T(0));
+                }
+
+            template <typename T>
+                void BatchedMonoRecursive<T>::reset(unsigned int network) {
+                    const unsigned int neurons = this->neurons();
+                    for(unsigned int i = 0; i < neurons; ++i) {
+                        _state[static_cast<std::size_t>(i) * _lanes + network] = T(0);
                     }
-                    delete[] _layer;
                 }
 
+            template <typename T>
+                template <typename F>
+                void BatchedMonoRecursive<T>::compute(const T* inSig, T* outSig, F* function) {
+                    const unsigned int neurons = this->neurons();
+                    // Signals: inputs, transposed, then the former states.
+                    for(unsigned int b = 0; b < _count; ++b) {
+                        const T* in = inSig + static_cast<std::size_t>(b) * _inCount;
+                        for(unsigned int j = 0; j < _inCount; ++j) {
+                            _signal[static_cast<std::size_t>(j) * _lanes + b] = in[j];
+                        }
+                    }
+                    std::memcpy(_signal + static_cast<std::size_t>(_inCount) * _lanes, _state,
+                            static_cast<std::size_t>(neurons) * _lanes * sizeof(T));
+
+                    const unsigned int rowBlocks = (neurons + NN_ROW_BLOCK - 1) / NN_ROW_BLOCK;
+                    const unsigned int laneBlocks = (_lanes + NN_LANE_BLOCK - 1) / NN_LANE_BLOCK;
+                    const unsigned int tiles = rowBlocks * laneBlocks;
+                    if(static_cast<std::size_t>(neurons) * signals() * _count >= NN_PARALLEL_THRESHOLD) {
+                        #pragma omp parallel for
+                        for(unsigned int t = 0; t < tiles; ++t) {
+                            const unsigned int row = (t % rowBlocks) * NN_ROW_BLOCK;
+                            const unsigned int lane = (t / rowBlocks) * NN_LANE_BLOCK;
+                            tile(row, neurons - row < NN_ROW_BLOCK ? neurons - row : NN_ROW_BLOCK,
+                                    lane, _lanes - lane < NN_LANE_BLOCK ? _lanes - lane : NN_LANE_BLOCK, function);
+                        }
+                    } else {
+                        for(unsigned int t = 0; t < tiles; ++t) {
+                            const unsigned int row = (t % rowBlocks) * NN_ROW_BLOCK;
+                            const unsigned int lane = (t / rowBlocks) * NN_LANE_BLOCK;
+                            tile(row, neurons - row < NN_ROW_BLOCK ? neurons - row : NN_ROW_BLOCK,
+                                    lane, _lanes - lane < NN_LANE_BLOCK ? _lanes - lane : NN_LANE_BLOCK, function);
+                        }
+                    }
+
+                    for(unsigned int b = 0; b < _count; ++b) {
+                        T* out = outSig + static_cast<std::size_t>(b) * _outCount;
+                        for(unsigned int i = 0; i < _outCount; ++i) {
+                            out[i] = _state[static_cast<std::size_t>(i) * _lanes + b];
+                        }
+                    }
+                }
+
+            template <typename T>
+                template <typename F>
+                void BatchedMonoRecursive<T>::tile(unsigned int row, unsigned int rows,
+                        unsigned int lane, unsigned int width, F* function) {
+                    const unsigned int signals = this->signals();
+                    const std::size_t lanes = _lanes;
+                    if(_shared) {
+                        for(unsigned int k = row; k < row + rows; ++k) {
+                            T* y = _state + k * lanes + lane;
+                            std::fill(y, y + width, T(0));
+                        }
+                        for(unsigned int j = 0; j < signals; ++j) {
+                            const T* x = _signal + j * lanes + lane;
+                            // The signal tile stays in cache for all the neurons of the tile.
+                            for(unsigned int k = row; k < row + rows; ++k) {
+                                T* y = _state + k * lanes + lane;
+                                const T w = _weight[static_cast<std::size_t>(k) * signals + j];
+                                #pragma omp simd aligned(x,y:NN_ALIGNMENT)
+                                for(unsigned int b = 0; b < width; ++b) {
+                                    y[b] += w * x[b];
+                                }
+                            }
+                        }
+                    } else {
+                        // Every weight is used once: sums of one SIMD width of networks
+                        // stay in registers over all the signals, instead of being
+                        // reloaded and stored for each of them, while their weights
+                        // are read as one contiguous stream.
+                        const unsigned int chunk = NN_ALIGNMENT / sizeof(T);
+                        const unsigned int neurons = this->neurons();
+                        for(unsigned int c = 0; c < width; c += chunk) {
+                            T sum[NN_ROW_BLOCK][NN_ALIGNMENT / sizeof(T)];
+                            for(unsigned int r = 0; r < NN_ROW_BLOCK; ++r) {
+                                for(unsigned int b = 0; b < chunk; ++b) {
+                                    sum[r][b] = T(0);
+                                }
+                            }
+                            const T* w = _weight + (static_cast<std::size_t>((lane + c) / chunk) * neurons + row)
+                                * signals * chunk;
+                            for(unsigned int j = 0; j < signals; ++j) {
+                                const T* x = _signal + j * lanes + lane + c;
+                                for(unsigned int r = 0; r < rows; ++r) {
+                                    const T* v = w + (static_cast<std::size_t>(r) * signals + j) * chunk;
+                                    #pragma omp simd aligned(x,v:NN_ALIGNMENT)
+                                    for(unsigned int b = 0; b < chunk; ++b) {
+                                        sum[r][b] += v[b] * x[b];
+                                    }
+                                }
+                            }
+                            for(unsigned int r = 0; r < rows; ++r) {
+                                T* y = _state + (row + r) * lanes + lane + c;
+                                for(unsigned int b = 0; b < chunk; ++b) {
+                                    y[b] = sum[r][b];
+                                }
+                            }
+                        }
+                    }
+                    for(unsigned int k = row; k < row + rows; ++k) {
+                        T* y = _state + k * lanes + lane;
+                        if(_shared) {
+                            const T bias = _bias[k];
+                            for(unsigned int b = 0; b < width; ++b) {
+                                y[b] = Activation<F, T>::neuron(function, y[b], bias);
+                            }
+                        } else {
+                            const T* bias = _bias + k * lanes + lane;
+                            for(unsigned int b = 0; b < width; ++b) {
+                                y[b] = Activation<F, T>::neuron(function, y[b], bias[b]);
+                            }
+                        }
+                        Activation<F, T>::layer(function, y, width);
+                    }
+                }
+
+            /**
+             * Simple Mono-Layer Recursive Neural-Net.
+             * Implementation of the core-engine of a lifetime
+             * home-brew neural net scheme.
+             * (Input(t), Output(t), Intermediate(t)) -> F -> (Output(t+1), Intermediate(t+1))
+             *
+             * Neuron parameters live in contiguous arrays, the weights and biases of
+             * a 'TrivialMonoRecursive', and the activation is a compile-time functor
+             * applied to the whole layer once its inputs are computed: there is no
+             * per-neuron object nor call to go through.
+             * @param <F> The activation function. There's only
+             *    one per neural-net in this case. It must be 'Vectorized':
+             *      void apply(T* values, unsigned int count) const;
+             *    e.g. 'Sigmoid', 'Tanh' or 'ReLU'.
+             * @param <T> Precision, 'float' or 'double'. Defaults to 'double'.
+             */
+            template <typename F, typename T = double> class MonoRecursive {
+                static_assert(Vectorized<F, T>::value, "MonoRecursive needs a vectorized activation.");
+                public:
+                    /**
+                     * Constructor. Weights and biases are zeroed.
+                     * @param input Number of input signals.
+                     * @param output Number of output signals.
+                     * @param intermediate Number of intermediate neurons.
+                     * @param activation Activation function.
+                     */
+                    MonoRecursive(unsigned int input, unsigned int output, unsigned int intermediate,
+                            const F& activation = F()) :
+                        _net(input, output, intermediate), _activation(activation) {}
+
+                    /**
+                     * Perform one computation step.
+                     * @param input Input vector (containing numbers in [0;1])
+                     * @param output Result vector (containing numbers in [0;1])
+                     */
+                    void compute(const T *input, T *output) {
+                        _net.compute(input, output, &_activation);
+                    }
+
+                    /**
+                     * Weights. See 'TrivialMonoRecursive::weights'.
+                     */
+                    T *weights() { return _net.weights(); }
+
+                    T *biases() { return _net.biases(); }
+
+                    unsigned int signals() const { return _net.signals(); }
+
+                    unsigned int neurons() const { return _net.neurons(); }
+
+                    unsigned int stride() const { return _net.stride(); }
+
+                    /**
+                     * Reset the neurons state.
+                     */
+                    void reset() { _net.reset(); }
+
+                    /**
+                     * @return Activation function.
+                     */
+                    F& activation() { return _activation; }
+
+                private:
+                    /**
+                     * Neuron parameters and state.
+                     */
+                    TrivialMonoRecursive<T> _net;
+
+                    /**
+                     * Activation function.
+                     */
+                    F _activation;
+            };
+
         } // Namespace 'NeuralNet'
     } // Namespace 'Logic'
 } // Namespace 'Headless'
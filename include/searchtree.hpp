@@ -15,12 +15,339 @@
  */
 #ifndef HEADLESS_LOGIC_SEARCH_TREE
 #define HEADLESS_LOGIC_SEARCH_TREE
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <queue>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
 #define DEFAULT_CARD 16
 #define VISIT_BUFFER_SIZE 32
+#define BATCH_CHUNK_SIZE 16
+#define SCAN_BLOCK_SIZE 64
 namespace Headless {
     namespace Logic {
         namespace SearchTree {
 
+            /**
+             * Memory arena.
+             * Released blocks are kept in free lists sorted by block size, so
+             * that nodes, sub-regions and element slots churned by splits and
+             * merges are recycled instead of hitting the global heap. Blocks are
+             * only given back to the system when the arena is destroyed.
+             * An arena is not thread-safe and can be shared by several trees.
+             */
+            class Arena {
+                public:
+                    /**
+                     * Constructor.
+                     */
+                    Arena() : _buckets(nullptr), _hits(0), _misses(0) {}
+
+                    /**
+                     * Destructor. Blocks still in use are not reclaimed.
+                     */
+                    ~Arena();
+
+                    /**
+                     * Acquire a block.
+                     * @param size Size of the block (in bytes).
+                     * @return An uninitialized block.
+                     */
+                    void* acquire(std::size_t size);
+
+                    /**
+                     * Release a block.
+                     * @param block Block previously acquired from this arena.
+                     * @param size Size of the block, as specified at acquisition.
+                     */
+                    void release(void* block, std::size_t size);
+
+                    /**
+                     * @return Number of acquisitions served by a free list.
+                     */
+                    unsigned long hits() const { return _hits; }
+
+                    /**
+                     * @return Number of acquisitions served by the global heap.
+                     */
+                    unsigned long misses() const { return _misses; }
+
+                private:
+                    Arena(const Arena&) = delete;
+                    Arena& operator=(const Arena&) = delete;
+
+                    /** Free block. */
+                    struct Chunk {
+                        Chunk* next;
+                    };
+
+                    /** Free list for a given block size. */
+                    struct Bucket {
+                        std::size_t size;
+                        Chunk* free;
+                        Bucket* next;
+                    };
+
+                    /**
+                     * Find (or create) the free list for the specified block size.
+                     * @param size Block size.
+                     * @return The free list.
+                     */
+                    Bucket* bucket(std::size_t size);
+
+                private:
+                    /** Free lists. */
+                    Bucket*       _buckets;
+                    /** Acquisitions served by a free list. */
+                    unsigned long _hits;
+                    /** Acquisitions served by the heap. */
+                    unsigned long _misses;
+            };
+
+            inline Arena::~Arena() {
+                while(nullptr != _buckets) {
+                    Bucket* bucket = _buckets;
+                    _buckets = bucket->next;
+                    while(nullptr != bucket->free) {
+                        Chunk* chunk = bucket->free;
+                        bucket->free = chunk->next;
+                        ::operator delete(chunk);
+                    }
+                    delete bucket;
+                }
+            }
+
+            inline Arena::Bucket* Arena::bucket(std::size_t size) {
+                Bucket* result = _buckets;
+                while(nullptr != result && result->size != size) {
+                    result = result->next;
+                }
+                if(nullptr == result) {
+                    result = new Bucket;
+                    result->size = size;
+                    result->free = nullptr;
+                    result->next = _buckets;
+                    _buckets = result;
+                }
+                return result;
+            }
+
+            inline void* Arena::acquire(std::size_t size) {
+                size = size < sizeof(Chunk) ? sizeof(Chunk) : size;
+                Bucket* list = bucket(size);
+                void* result;
+                if(nullptr != list->free) {
+                    result = list->free;
+                    list->free = list->free->next;
+                    ++_hits;
+                } else {
+                    result = ::operator new(size);
+                    ++_misses;
+                }
+                return result;
+            }
+
+            inline void Arena::release(void* block, std::size_t size) {
+                if(nullptr != block) {
+                    size = size < sizeof(Chunk) ? sizeof(Chunk) : size;
+                    Bucket* list = bucket(size);
+                    Chunk* chunk = static_cast<Chunk*>(block);
+                    chunk->next = list->free;
+                    list->free = chunk;
+                }
+            }
+
+            /**
+             * Plain heap allocator. Every acquisition and release goes
+             * straight to the global heap.
+             */
+            class Heap {
+                public:
+                    void* acquire(std::size_t size) { return ::operator new(size); }
+                    void release(void* block, std::size_t) { ::operator delete(block); }
+            };
+
+            /**
+             * Default node aggregate: nothing is maintained.
+             */
+            class Unaggregated {
+                public:
+                    void clear() {}
+                    template <typename K, typename E> void add(const K&, const E*) {}
+                    template <typename K, typename E> void remove(const K&, const E*) {}
+                    void add(const Unaggregated&) {}
+            };
+
+            /**
+             * Tell if a region can be divided in a provided storage, i.e. if it
+             * implements 'void divide(R*) const'.
+             * @param <R> Region concept.
+             */
+            template <typename R> class Divisible {
+                private:
+                    template <typename T> static char test(
+                            decltype(std::declval<const T&>().divide(static_cast<T*>(nullptr)))*);
+                    template <typename T> static long test(...);
+                public:
+                    static const bool value = sizeof(test<R>(nullptr)) == sizeof(char);
+            };
+
+            /**
+             * Tell if a region provides a lower bound of the distance between a
+             * key and its content, i.e. if it implements 'double distance(const K&) const'.
+             * @param <R> Region concept.
+             * @param <K> Key concept.
+             */
+            template <typename R, typename K> class Measurable {
+                private:
+                    template <typename T> static char test(
+                            decltype(std::declval<const T&>().distance(std::declval<const K&>()))*);
+                    template <typename T> static long test(...);
+                public:
+                    static const bool value = sizeof(test<R>(nullptr)) == sizeof(char);
+            };
+
+            /**
+             * Compile-time fan-out of a region, i.e. the value of 'R::FANOUT'
+             * if the region declares such a constant, 0 otherwise.
+             * @param <R> Region concept.
+             */
+            template <typename R> class Fanout {
+                private:
+                    template <typename T> static std::integral_constant<unsigned int, T::FANOUT> test(int);
+                    template <typename T> static std::integral_constant<unsigned int, 0> test(...);
+                public:
+                    static const unsigned int value = decltype(test<R>(0))::value;
+            };
+
+            /**
+             * Tell if a region can compute the index of the sub-region hosting
+             * a key, i.e. if it implements 'unsigned int index(const K&) const'.
+             * @param <R> Region concept.
+             * @param <K> Key concept.
+             */
+            template <typename R, typename K> class Indexable {
+                private:
+                    template <typename T> static char test(
+                            decltype(std::declval<const T&>().index(std::declval<const K&>()))*);
+                    template <typename T> static long test(...);
+                public:
+                    static const bool value = sizeof(test<R>(nullptr)) == sizeof(char);
+            };
+
+            /**
+             * Tell if a region can encode a key by itself, i.e. if it implements
+             * 'unsigned long long code(const K&, unsigned int depth) const'.
+             * @param <R> Region concept.
+             * @param <K> Key concept.
+             */
+            template <typename R, typename K> class Encodable {
+                private:
+                    template <typename T> static char test(
+                            decltype(std::declval<const T&>().code(std::declval<const K&>(), 0u))*);
+                    template <typename T> static long test(...);
+                public:
+                    static const bool value = sizeof(test<R>(nullptr)) == sizeof(char);
+            };
+
+            /**
+             * Tell if a search function can test a batch of keys at once, i.e. if it
+             * implements 'void contains(const K* keys, unsigned int count, unsigned char* mask) const',
+             * setting 'mask[i]' to non-zero when 'keys[i]' is contained.
+             * @param <S> Search function concept.
+             * @param <K> Key concept.
+             */
+            template <typename S, typename K> class Batched {
+                private:
+                    template <typename T> static char test(
+                            decltype(std::declval<const T&>().contains(std::declval<const K*>(),
+                                    0u, std::declval<unsigned char*>()))*);
+                    template <typename T> static long test(...);
+                public:
+                    static const bool value = sizeof(test<S>(nullptr)) == sizeof(char);
+            };
+
+            /**
+             * Sink storing streamed elements into a bounded buffer. The stream
+             * is stopped by the first element that does not fit.
+             * @param <E> Element concept.
+             */
+            template <typename E> class Collector {
+                public:
+                    Collector(E** buffer, unsigned int size) :
+                        _buffer(buffer), _size(size), _count(0), _overflow(false) {}
+                    bool operator()(E* element) {
+                        if(_count < _size) {
+                            _buffer[_count] = element;
+                            ++_count;
+                            return true;
+                        }
+                        _overflow = true;
+                        return false;
+                    }
+                    /** @return Number of stored elements. */
+                    unsigned int count() const { return _count; }
+                    /** @return true if an element did not fit. */
+                    bool overflow() const { return _overflow; }
+                private:
+                    E** _buffer;
+                    unsigned int _size;
+                    unsigned int _count;
+                    bool _overflow;
+            };
+
+            /**
+             * Tree statistics, see 'Node::statistics'. Depths count levels, the
+             * root being at depth 1.
+             */
+            struct Statistics {
+                /** Number of nodes, leaves included. */
+                unsigned long nodes;
+                /** Number of leaves. */
+                unsigned long leaves;
+                /** Number of stored elements. */
+                unsigned long elements;
+                /** Depth of the deepest leaf. */
+                unsigned int maxDepth;
+                /** Mean depth of the elements, i.e. of their leaves. */
+                double averageDepth;
+                /** Bytes held by the tree: nodes, sub-regions, element slots. */
+                std::size_t bytes;
+                /** Leaves split since the tree creation. */
+                unsigned long splits;
+                /** Nodes merged since the tree creation. */
+                unsigned long merges;
+                /** Number of leaves by element count, from 0 to the cardinality. */
+                std::vector<unsigned long> fill;
+            };
+
+            /**
+             * Visitor counting the nodes and elements a search goes through,
+             * as a query cost probe:
+             *   tree.retrieve(func, buffer, size, &probe);
+             */
+            class Probe {
+                public:
+                    Probe() : _nodes(0), _elements(0) {}
+                    template <typename R> void enter(const R&) { ++_nodes; }
+                    template <typename R> void exit(const R&) {}
+                    template <typename E> void inspect(E**, unsigned int count) { _elements += count; }
+                    template <typename E> void inspect(E*) { ++_elements; }
+                    /** @return Number of visited nodes. */
+                    unsigned long nodes() const { return _nodes; }
+                    /** @return Number of inspected elements, fetched or tested. */
+                    unsigned long elements() const { return _elements; }
+                    /** Reset the counters. */
+                    void reset() { _nodes = 0; _elements = 0; }
+                private:
+                    unsigned long _nodes;
+                    unsigned long _elements;
+            };
+
             /**
              * Search Tree Node.
              *
@@ -31,7 +358,9 @@ namespace Headless {
              * - Remove an element (by instance or by key).
              * - Find elements within the distance from a key.
              * @param <K> Key concept. The distance computation is assumed by
-             *     the provided Region instance.
+             *     the provided Region instance. Keys are copied next to the
+             *     element slots of the leaves, so the key must be trivially
+             *     copyable and not more aligned than a pointer.
              * @param <R> Region concept. The unfamous one. Must implement the following methods:
              *     Key containment.
              *         bool contains(const K&) const;
@@ -39,13 +368,44 @@ namespace Headless {
              *         unsigned int dimension() const;
              *     Divide the region.
              *         R* divide() const;
+             *     Optionally, divide the region in the provided storage of
+             *     'dimension()' default-constructed regions. When available, it
+             *     is preferred and sub-regions are stored in the allocator.
+             *         void divide(R*) const;
+             *     Optionally, declare the subdivision cardinality as a compile-time
+             *     constant, equal to 'dimension()'.
+             *         static const unsigned int FANOUT;
+             *     Optionally, compute the index of the sub-region (as ordered by
+             *     'divide') hosting a key of the region. The sub-region must contain
+             *     the key. Replaces containment tests when descending the tree.
+             *         unsigned int index(const K&) const;
+             *     Optionally, provide a lower bound of the distance between a key
+             *     and any key within the region (0 if inside). Used to prune
+             *     nearest neighbour searches.
+             *         double distance(const K&) const;
              * @param <E> Element concept. Must expose the following methods :
              *     Get the key.
              *         const K& key() const;
              *     Set the key.
              *         void key(const K&);
+             * @param <A> Allocator concept. Source of nodes, sub-regions and element
+             *     slots. Must implement the following methods:
+             *         void* acquire(std::size_t);
+             *         void release(void*, std::size_t);
+             * @param <G> Aggregate concept. Summary of the elements of a sub-tree
+             *     (count, centroid, ...), maintained by each node as elements are
+             *     added, removed and moved. Must be default constructible and
+             *     implement the following methods:
+             *         void clear();
+             *         void add(const K&, const E*);
+             *         void remove(const K&, const E*);
+             *     Merge the summary of another set of elements.
+             *         void add(const G&);
              */
-            template <typename K, typename R, typename E> class Node {
+            template <typename K, typename R, typename E, typename A = Arena,
+                     typename G = Unaggregated> class Node {
+                static_assert(alignof(K) <= alignof(E*), "Keys are stored after the element slots.");
+                static_assert(std::is_trivially_copyable<K>::value, "Keys are cached by raw copies.");
                 public:
                     /**
                      * Default visitor.
@@ -65,9 +425,12 @@ namespace Headless {
                      * @param region A node is defined for a particular region key.
                      * @param cardinality Maximum number of stored elements.
                      * @param parent optional parent. nullptr if root.
+                     * @param allocator optional allocator. If nullptr, the parent one
+                     * is used or, for a root, a private allocator is created.
                      */
                     Node(const R* region,
-                            unsigned int cardinality = DEFAULT_CARD, Node *parent = nullptr);
+                            unsigned int cardinality = DEFAULT_CARD, Node *parent = nullptr,
+                            A* allocator = nullptr);
                     /**
                      * Destructor.
                      */
@@ -75,19 +438,61 @@ namespace Headless {
                     /**
                      * Add an element.
                      * @param element Pointer to the element to add.
+                     * @return The leaf hosting the element, usable as a handle
+                     * for 'move' and 'remove'. nullptr if the element key is
+                     * outside the tree region.
                      */
-                    void add(E* element);
+                    Node* add(E* element);
                     /**
                      * Remove an element.
                      * @param element Pointer to the element instance to remove.
                      */
                     void remove(E* element);
+                    /**
+                     * Remove an element, starting from its leaf.
+                     * @param element Pointer to the element instance to remove.
+                     * @param leaf Leaf handle, as returned by 'add' or updated by 'move'.
+                     * A stale handle is detected, the element is then searched from this node.
+                     */
+                    void remove(E* element, Node* leaf);
                     /**
                      * Move an element within the tree.
                      * @param element Element to be moved.
                      * @param key Target key.
                      */
                     void move(E* element, K &key);
+                    /**
+                     * Move an element within the tree, starting from its leaf.
+                     * If the element stays in its leaf, no descent occurs at all.
+                     * Otherwise, relocation starts from the lowest common ancestor.
+                     * Nodes are kept until the tree is destroyed, so any handle
+                     * can safely be checked against the element.
+                     * @param element Element to be moved.
+                     * @param key Target key.
+                     * @param leaf Leaf handle. A stale handle is detected, the element
+                     * is then searched from this node. Updated with the new leaf.
+                     */
+                    void move(E* element, K &key, Node*& leaf);
+                    /**
+                     * Move a batch of elements within the tree.
+                     * Keys are updated in place and only the elements leaving
+                     * their leaf are relocated. Merges are deferred to the end
+                     * of the batch, so that a merge is not undone by the next split.
+                     * @param elements Elements to be moved.
+                     * @param keys Target keys, one per element.
+                     * @param count Number of elements.
+                     * @param leaves Optional leaf handles, one per element. Updated.
+                     */
+                    void moveAll(E** elements, K* keys, unsigned int count, Node** leaves = nullptr);
+                    /**
+                     * Replace the content of the tree with a batch of elements.
+                     * The batch is partitioned top-down in a single pass, giving the
+                     * same tree shape as adding the elements one by one into an
+                     * empty tree. Elements outside the region are ignored.
+                     * @param elements Elements to store. The array is reordered.
+                     * @param count Number of elements.
+                     */
+                    void build(E** elements, unsigned int count);
                     /**
                      * Retrieve elements with a certain distance from the
                      * specified key.
@@ -95,16 +500,101 @@ namespace Headless {
                      * @param buffer Storage for eligible elements.
                      * @param size Size of the buffer.
                      * @param visitor Optional visitor.
+                     * @param overflow Optional flag, set to true if there are more
+                     * eligible elements than 'size' (the search then stops), false
+                     * otherwise.
                      * @param <S> Search function type. This concept must implement
                      * the following methods:
                      *   int contains(const R&); <- Partially or fully contains a region.
                      *   bool contains(const K&); <- Contains a key.
                      * @param <V> Visitor concept.
-                     * @return Number of eligible elements. If there's more
-                     * eligible elements than 'size', return the negative value.
+                     * @return Number of elements stored in the buffer.
                      */
                     template <typename S, typename V = Visitor> unsigned int retrieve(const S& func,
-                            E** buffer, unsigned int size, V* visitor = nullptr) const;
+                            E** buffer, unsigned int size, V* visitor = nullptr,
+                            bool* overflow = nullptr) const;
+                    /**
+                     * Stream the elements matching a search function to a sink,
+                     * without intermediate storage.
+                     * @param func Search function. See above.
+                     * @param sink Element consumer. Returns false to stop the search:
+                     *   bool operator()(E* element);
+                     * @param visitor Optional visitor.
+                     * @return false if the sink stopped the search.
+                     */
+                    template <typename S, typename C, typename V = Visitor> bool retrieve(const S& func,
+                            C& sink, V* visitor = nullptr) const;
+                    /**
+                     * Retrieve the nearest elements from a key.
+                     * The tree is traversed best-first, nodes being sorted by the
+                     * region distance lower bound, if the region provides one.
+                     * @param key Reference key.
+                     * @param k Maximum number of elements to retrieve.
+                     * @param buffer Storage for at least 'k' elements. At return, sorted
+                     * from the nearest to the farthest.
+                     * @param metric Distance between keys. Must be expressed in the same
+                     * unit as the region lower bound.
+                     * @param distances Optional storage for at least 'k' distances,
+                     * matching the buffer elements.
+                     * @param <D> Metric concept. Must implement the following method:
+                     *   double distance(const K&, const K&) const;
+                     * @return Number of retrieved elements.
+                     */
+                    template <typename D> unsigned int nearest(const K& key, unsigned int k,
+                            E** buffer, const D& metric, double* distances = nullptr) const;
+                    /**
+                     * Run a batch of retrievals, spread over threads when compiled
+                     * with OpenMP. The tree is only read, so it must not be modified
+                     * until the call returns. Each thread uses its own buffer.
+                     * @param queries Query provider, called concurrently. Gives the
+                     * search function of a query (see 'retrieve'):
+                     *   const S& operator()(unsigned int index) const;
+                     * @param count Number of queries.
+                     * @param size Size of the per-thread buffers.
+                     * @param consumer Result consumer, called concurrently with distinct
+                     * query indices. The elements array is only valid during the call:
+                     *   void operator()(unsigned int index, E** elements, unsigned int count);
+                     */
+                    template <typename Q, typename C> void retrieveAll(const Q& queries,
+                            unsigned int count, unsigned int size, C& consumer) const;
+                    /**
+                     * Visit each pair of nearby leaves once (dual-tree traversal), so that
+                     * symmetric interactions are computed once per pair of elements.
+                     * Sub-trees are opened together as long as the proximity test holds.
+                     * @param proximity Tell if elements of two regions may interact:
+                     *   bool near(const R&, const R&) const;
+                     * @param kernel Interaction between two blocks of elements and their
+                     * keys. The blocks are the same for the pairs within a leaf, in which
+                     * case the kernel must only consider each pair once:
+                     *   void operator()(E** first, const K* firstKeys, unsigned int firstCount,
+                     *          E** second, const K* secondKeys, unsigned int secondCount);
+                     */
+                    template <typename N, typename C> void pairs(const N& proximity, C& kernel) const;
+                    /**
+                     * Approximate retrieval (Barnes-Hut). Sub-trees are pruned by the
+                     * search function as in 'retrieve', but those the criterion does
+                     * not open are streamed as a single summary instead of descending.
+                     * @param func Search function. See 'retrieve'.
+                     * @param criterion Opening criterion. Returns true to descend into
+                     * a sub-tree, false to use its summary:
+                     *   bool open(const R& region, const G& aggregate) const;
+                     * @param sink Consumer of elements and summaries. Returns false to
+                     * stop the search:
+                     *   bool operator()(E* element);
+                     *   bool operator()(const R& region, const G& aggregate);
+                     * @return false if the sink stopped the search.
+                     */
+                    template <typename S, typename O, typename C> bool approximate(const S& func,
+                            const O& criterion, C& sink) const;
+                    /**
+                     * @return Summary of the elements of the sub-tree.
+                     */
+                    const G& aggregate() const { return _aggregate; }
+                    /**
+                     * Recompute all the aggregates of the sub-tree bottom-up, e.g. when
+                     * the element data they summarize changed outside of the tree.
+                     */
+                    void refresh();
                     /**
                      * Recursive visit of the tree.
                      * @param <V> Visitor concept.
@@ -114,28 +604,257 @@ namespace Headless {
                      */
                     template <typename V> void visit(V& visitor);
 
+                    /**
+                     * Set the merge policy.
+                     * @param threshold A node turns back into a leaf as soon as its
+                     * sub-nodes hold no more than 'threshold' elements. Clamped to, and
+                     * defaults to, the cardinality. Lower values keep nodes divided
+                     * longer, avoiding split/merge thrashing around region boundaries.
+                     * @param deferred If true, nodes are only merged by 'compact'.
+                     */
+                    void policy(unsigned int threshold, bool deferred = false);
+                    /**
+                     * Merge all the nodes whose sub-nodes fit in a single leaf,
+                     * whatever the merge policy.
+                     */
+                    void compact();
+                    /**
+                     * @return Number of leaves split since the tree creation.
+                     */
+                    unsigned long splits() const { return _state->splits; }
+                    /**
+                     * @return Number of nodes merged since the tree creation.
+                     */
+                    unsigned long merges() const { return _state->merges; }
+
+                    /**
+                     * Walk the sub-tree and report its shape and memory use. Nothing is
+                     * maintained for it, so it costs nothing until called. Query costs are
+                     * measured by passing a 'Probe' as retrieval visitor.
+                     * @return Statistics of the sub-tree.
+                     */
+                    Statistics statistics() const;
+
+                    /**
+                     * @return The allocator used by the tree.
+                     */
+                    const A* allocator() const { return _allocator; }
+
 #ifdef TREE_DEBUG
                     template <typename V> void deepVisit(V &visitor);
 #endif
 
                 private:
+                    Node(const Node&) = delete;
+                    Node& operator=(const Node&) = delete;
+
+                    /**
+                     * Tree-wide state. Owned by the root and shared by all the nodes.
+                     */
+                    struct State {
+                        /** Merge threshold. */
+                        unsigned int threshold;
+                        /** Merge only on compaction. */
+                        bool deferred;
+                        /** Split count. */
+                        unsigned long splits;
+                        /** Merge count. */
+                        unsigned long merges;
+                    };
+
                     /**
-                     * Fetch the entire content of the tree.
-                     * @param buffer Array in which to fetch elements.
-                     * @param size Size of this array.
+                     * Stream the entire content of the sub-tree to a sink.
+                     * @param sink Element consumer.
                      * @param visitor Optional visitor.
-                     * @param <V> Visitor concept.
-                     * @return Number of retrieved elements.
+                     * @return false if the sink stopped the search.
+                     */
+                    template <typename C, typename V> bool fetch(C& sink, V* visitor) const;
+                    /**
+                     * Visit the nearby leaf pairs of two sub-trees. See 'pairs'.
+                     * @param other Other sub-tree, this one for pairs within the sub-tree.
+                     * @param proximity Proximity test.
+                     * @param kernel Pair kernel.
+                     */
+                    template <typename N, typename C> void pairs(const Node* other,
+                            const N& proximity, C& kernel) const;
+                    /**
+                     * Accumulate the statistics of the sub-tree.
+                     * @param statistics Statistics to update.
+                     * @param depth Depth of this node.
+                     * @param depthSum Sum of the element depths.
+                     */
+                    void gather(Statistics& statistics, unsigned int depth, double& depthSum) const;
+                    /**
+                     * @return Bytes held by the sub-tree, dormant sub-nodes included.
                      */
-                    template <typename V = Visitor> unsigned int fetch(E** buffer,
-                            unsigned int size, V* visitor = nullptr) const;
+                    std::size_t bytes() const;
+                    /**
+                     * Account for an element entering or leaving this leaf, in the
+                     * aggregates of the leaf and all of its ancestors.
+                     * @param key Element key.
+                     * @param element Element.
+                     */
+                    void enter(const K& key, const E* element) {
+                        if(Aggregated) {
+                            for(Node* node = this; nullptr != node; node = node->_parent) {
+                                node->_aggregate.add(key, element);
+                            }
+                        }
+                    }
+                    void leave(const K& key, const E* element) {
+                        if(Aggregated) {
+                            for(Node* node = this; nullptr != node; node = node->_parent) {
+                                node->_aggregate.remove(key, element);
+                            }
+                        }
+                    }
                     /**
                      * Find the leaf that can possibly host the key.
                      * @param key Node key to locate.
                      * @return A leaf or nullptr if the key is outside the master region.
                      */
                     Node* find(const K& key);
+                    /**
+                     * Find the leaf storing an element. Unlike 'find', all the
+                     * leaves containing the element key are searched, so the
+                     * element may lie on the boundary of several regions.
+                     * @param element Element to locate.
+                     * @param slot Position of the element in the leaf slots.
+                     * @return The leaf or nullptr if the element is not stored.
+                     */
+                    Node* locate(E* element, unsigned int& slot);
+                    /**
+                     * Tell if this node is a leaf storing the specified element.
+                     * @param element Element to look for.
+                     * @param slot Position of the element in the leaf slots.
+                     * @return true if found.
+                     */
+                    bool holds(E* element, unsigned int& slot) const;
+                    /**
+                     * Merge a node ancestors as long as their sub-nodes fit
+                     * in a single leaf.
+                     * @param node Node from which to start.
+                     * @return The last merged node, or 'node' if none.
+                     */
+                    Node* cascade(Node* node);
+                    /**
+                     * Merge, bottom-up, all the nodes of the sub-tree whose sub-nodes
+                     * fit in a single leaf.
+                     * @param threshold Merge threshold.
+                     * @return Number of elements stored in the sub-tree.
+                     */
+                    unsigned int rebalance(unsigned int threshold);
+                    /**
+                     * Turn a full leaf into a node, dispatching its elements
+                     * among its sub-nodes. Sub-nodes are allocated on first split
+                     * and kept afterward.
+                     */
+                    void split();
+                    /**
+                     * Turn a node whose sub-nodes are leaves back into a leaf.
+                     * Sub-nodes are kept but their element slots are released.
+                     */
+                    void merge();
+                    /**
+                     * Store a batch of elements under this node, dividing it
+                     * as long as the batch exceeds the cardinality.
+                     * @param elements Elements, all contained by the node region.
+                     * @param count Number of elements.
+                     */
+                    void fill(E** elements, unsigned int count);
+                    /**
+                     * Turn the node into an empty leaf. Sub-nodes are kept,
+                     * but emptied and stripped of their element slots.
+                     */
+                    void collapse();
+                    /**
+                     * Empty the sub-tree and release all of its element slots.
+                     */
+                    void retire();
+                    /**
+                     * Allocate sub-nodes.
+                     */
+                    void subdivide();
+                    /**
+                     * Divide the region, using the region own storage.
+                     * @return Sub-regions.
+                     */
+                    const R* divide(std::false_type);
+                    /**
+                     * Divide the region, using the allocator storage.
+                     * @return Sub-regions.
+                     */
+                    const R* divide(std::true_type);
+                    /**
+                     * Release sub-regions obtained from 'divide'.
+                     * @param regions Sub-regions.
+                     * @param dimension Number of sub-regions.
+                     */
+                    void release(const R* regions, unsigned int dimension, std::false_type);
+                    void release(const R* regions, unsigned int dimension, std::true_type);
+                    /**
+                     * @return A fresh set of element slots, followed by their key cache.
+                     */
+                    E** slots();
+                    /**
+                     * @return Size (in bytes) of a set of element slots and their keys.
+                     */
+                    std::size_t footprint() const { return _cardinality * (sizeof(E*) + sizeof(K)); }
+                    /**
+                     * @return Cached keys of the leaf elements, by slot.
+                     */
+                    K* keys() { return reinterpret_cast<K*>(_elements + _cardinality); }
+                    const K* keys() const { return reinterpret_cast<const K*>(_elements + _cardinality); }
+                    /**
+                     * Stream the leaf elements matching a search function to a sink.
+                     * The search function is given cached keys, in blocks when it
+                     * supports batched tests.
+                     * @param func Search function.
+                     * @param sink Element consumer.
+                     * @param visitor Optional visitor.
+                     * @return false if the sink stopped the search.
+                     */
+                    template <typename S, typename C, typename V> bool scan(const S& func,
+                            C& sink, V* visitor, std::true_type) const;
+                    template <typename S, typename C, typename V> bool scan(const S& func,
+                            C& sink, V* visitor, std::false_type) const;
+                    /**
+                     * @return Number of sub-nodes, known at compile-time when
+                     * the region declares its fan-out.
+                     */
+                    unsigned int fanout() const {
+                        return Fanout<R>::value != 0 ? Fanout<R>::value : _region->dimension();
+                    }
+                    /**
+                     * Tell if a sub-node is the one hosting a key.
+                     * @param index Sub-node index.
+                     * @param key Key, contained by the node region.
+                     * @return true if the sub-node is the region pick, or if it is
+                     * the first sub-node containing the key.
+                     */
+                    bool owns(unsigned int index, const K& key, std::true_type) const {
+                        return _region->index(key) == index;
+                    }
+                    bool owns(unsigned int index, const K& key, std::false_type) const {
+                        return _nodes[index]._region->contains(key);
+                    }
+                    /**
+                     * Get the sub-node hosting a key.
+                     * @param key Key, contained by the node region.
+                     * @return The sub-node, or nullptr if none contains the key.
+                     */
+                    Node* child(const K& key, std::true_type) { return _nodes + _region->index(key); }
+                    Node* child(const K& key, std::false_type);
+                    /**
+                     * Lower bound of the distance between a key and the node content.
+                     * @param key Reference key.
+                     * @return The region distance, or 0 if the region can't tell.
+                     */
+                    double bound(const K& key, std::true_type) const { return _region->distance(key); }
+                    double bound(const K&, std::false_type) const { return 0.0; }
                 private:
+                    /** Tell if aggregates are maintained at all. */
+                    static const bool Aggregated = !std::is_same<G, Unaggregated>::value;
                     /** Region of interest. */
                     const R*                 _region;
                     /** Stored elements. 'null' if not leaf. */
@@ -144,64 +863,136 @@ namespace Headless {
                     unsigned int             _count;
                     /** Maximum number of elements. */
                     unsigned int             _cardinality;
-                    /** Sub-node. 'null' if leaf. */
-                    Node<K, R, E>**          _nodes;
+                    /** Sub-nodes, stored contiguously. 'null' if never divided. */
+                    Node<K, R, E, A, G>*        _nodes;
                     /** Parent node. */
-                    Node<K, R, E>*           _parent;
+                    Node<K, R, E, A, G>*        _parent;
+                    /** Allocator. */
+                    A*                       _allocator;
+                    /** Tree-wide state. */
+                    State*                   _state;
                     /** Leaf indicator. Indirect recycling info. */
                     bool                     _leaf;
+                    /** Allocator ownership. */
+                    bool                     _owner;
+                    /** Summary of the sub-tree elements. */
+                    G                        _aggregate;
             };
 
-            template <typename K, typename R, typename E>
-                Node<K, R, E>::Node(const R* region, unsigned int card, Node<K, R, E>* parent) :
-                    _region(region), _elements(new E*[card]), _count(0),
-                    _cardinality(card), _nodes(nullptr), _parent(parent), _leaf(true) {
+            template <typename K, typename R, typename E, typename A, typename G>
+                Node<K, R, E, A, G>::Node(const R* region, unsigned int card, Node<K, R, E, A, G>* parent,
+                        A* allocator) :
+                    _region(region), _elements(nullptr), _count(0),
+                    _cardinality(card), _nodes(nullptr), _parent(parent),
+                    _allocator(allocator), _state(nullptr), _leaf(true), _owner(false) {
+                        if(nullptr != parent) {
+                            _state = parent->_state;
+                        } else {
+                            _state = new State;
+                            _state->threshold = card;
+                            _state->deferred = false;
+                            _state->splits = 0;
+                            _state->merges = 0;
+                        }
+                        if(nullptr == _allocator) {
+                            if(nullptr != parent) {
+                                _allocator = parent->_allocator;
+                            } else {
+                                _allocator = new A();
+                                _owner = true;
+                            }
+                        }
+                        _elements = slots();
                     }
 
-            template <typename K, typename R, typename E>
-                Node<K, R, E>::~Node() {
-                    delete []_elements;
+            template <typename K, typename R, typename E, typename A, typename G>
+                Node<K, R, E, A, G>::~Node() {
+                    if(nullptr != _elements) {
+                        _allocator->release(_elements, footprint());
+                    }
                     if(_nodes != nullptr) {
-                        unsigned int dimension = _region->dimension();
-                        const R* region = _nodes[0]->_region;
+                        unsigned int dimension = fanout();
+                        const R* region = _nodes[0]._region;
                         for(unsigned int i = 0; i < dimension; ++i) {
-                            delete _nodes[i];
+                            _nodes[i].~Node();
+                        }
+                        _allocator->release(_nodes, dimension * sizeof(Node<K, R, E, A, G>));
+                        release(region, dimension, std::integral_constant<bool, Divisible<R>::value>());
+                    }
+                    if(nullptr == _parent) {
+                        delete _state;
+                    }
+                    if(_owner) {
+                        delete _allocator;
+                    }
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                E** Node<K, R, E, A, G>::slots() {
+                    return static_cast<E**>(_allocator->acquire(footprint()));
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                const R* Node<K, R, E, A, G>::divide(std::false_type) {
+                    return _region->divide();
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                const R* Node<K, R, E, A, G>::divide(std::true_type) {
+                    unsigned int dimension = _region->dimension();
+                    R* regions = static_cast<R*>(_allocator->acquire(dimension * sizeof(R)));
+                    for(unsigned int i = 0; i < dimension; ++i) {
+                        new (regions + i) R();
+                    }
+                    _region->divide(regions);
+                    return regions;
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                void Node<K, R, E, A, G>::release(const R* regions, unsigned int, std::false_type) {
+                    delete []regions;
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                void Node<K, R, E, A, G>::release(const R* regions, unsigned int dimension, std::true_type) {
+                    for(unsigned int i = 0; i < dimension; ++i) {
+                        regions[i].~R();
+                    }
+                    _allocator->release(const_cast<R*>(regions), dimension * sizeof(R));
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                void Node<K, R, E, A, G>::subdivide() {
+                    unsigned int dimension = fanout();
+                    const R* regions = divide(std::integral_constant<bool, Divisible<R>::value>());
+                    _nodes = static_cast<Node<K, R, E, A, G>*>(
+                            _allocator->acquire(dimension * sizeof(Node<K, R, E, A, G>)));
+                    for(unsigned int i = 0; i < dimension; ++i) {
+                        new (_nodes + i) Node<K, R, E, A, G>(regions + i, _cardinality, this, _allocator);
+                    }
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                Node<K, R, E, A, G>* Node<K, R, E, A, G>::child(const K& key, std::false_type) {
+                    Node<K, R, E, A, G>* result = nullptr;
+                    unsigned int dimension = fanout();
+                    for(unsigned int i = 0; i < dimension; ++i) {
+                        if(_nodes[i]._region->contains(key)) {
+                            result = _nodes + i;
+                            break;
                         }
-                        delete []region;
-                        delete []_nodes;
                     }
+                    return result;
                 }
 
-            template <typename K, typename R, typename E>
-                Node<K, R, E>* Node<K, R, E>::find(const K& key) {
-                    Node<K, R, E>* result;
+            template <typename K, typename R, typename E, typename A, typename G>
+                Node<K, R, E, A, G>* Node<K, R, E, A, G>::find(const K& key) {
+                    typedef std::integral_constant<bool, Indexable<R, K>::value> Indexed;
+                    Node<K, R, E, A, G>* result;
                     if(_region->contains(key)) {
                         result = this;
-                        Node<K, R, E>** nodes;
-#ifdef TREE_DEBUG
-                        bool loop;
-#endif
-                        while(!result->_leaf) {
-                            nodes = result->_nodes;
-#ifdef TREE_DEBUG
-                            loop = true;
-#endif
-                            unsigned int count = result->_region->dimension();
-                            for(unsigned int i = 0; i < count; ++i) {
-                                if(nodes[i]->_region->contains(key)) {
-                                    result = nodes[i];
-#ifdef TREE_DEBUG
-                                    loop = false;
-#endif
-                                    break;
-                                }
-                            }
-#ifdef TREE_DEBUG
-                            if(loop) {
-                                result = nullptr;
-                                break;
-                            }
-#endif
+                        while(nullptr != result && !result->_leaf) {
+                            result = result->child(key, Indexed());
                         }
                     } else {
                         result = nullptr;
@@ -209,114 +1000,402 @@ namespace Headless {
                     return result;
                 }
 
-            template <typename K, typename R, typename E>
-                void Node<K, R, E>::add(E* element) {
-                    const K& key = element->key();
-                    Node<K, R, E>* node = find(key);
-                    if(nullptr != node) {
-                        while(_cardinality == node->_count) {
-                            node->_leaf = false;
-                            unsigned int dimension = node->_region->dimension();
-                            if(nullptr == node->_nodes) {
-                                node->_nodes = new Node<K, R, E>*[dimension];
-                                const R* regions = node->_region->divide();
-                                for(unsigned int i = 0; i < dimension; ++i) {
-                                    node->_nodes[i] = new Node<K, R, E>(regions + i, _cardinality, node);
-                                }
+            template <typename K, typename R, typename E, typename A, typename G>
+                void Node<K, R, E, A, G>::split() {
+                    typedef std::integral_constant<bool, Indexable<R, K>::value> Indexed;
+                    _leaf = false;
+                    ++_state->splits;
+                    if(nullptr == _nodes) {
+                        subdivide();
+                    }
+                    unsigned int dimension = fanout();
+                    E** toShare = _elements;
+                    K* sharedKeys = keys();
+                    unsigned int shareCount = _count;
+                    Node<K, R, E, A, G>* target;
+                    for(unsigned int i = 0; i < dimension; ++i) {
+                        target = _nodes + i;
+                        if(nullptr == target->_elements) {
+                            target->_elements = target->slots();
+                        }
+                        target->_count = 0;
+                        target->_aggregate.clear();
+                        K* targetKeys = target->keys();
+                        for(unsigned int j = 0; j < shareCount;) {
+                            if(owns(i, sharedKeys[j], Indexed())) {
+                                target->_elements[target->_count] = toShare[j];
+                                targetKeys[target->_count] = sharedKeys[j];
+                                target->_aggregate.add(sharedKeys[j], toShare[j]);
+                                ++target->_count;
+                                --shareCount;
+                                toShare[j] = toShare[shareCount];
+                                sharedKeys[j] = sharedKeys[shareCount];
+                            } else {
+                                ++j;
                             }
-                            E** toShare = node->_elements;
-                            unsigned int shareCount = node->_count;
-                            Node<K, R, E>* target;
-                            for(unsigned int i = 0; i < dimension; ++i) {
-                                target = node->_nodes[i];
-                                target->_count = 0;
-                                for(unsigned int j = 0; j < shareCount;) {
-                                    if(target->_region->contains(toShare[j]->key())) {
-                                        target->_elements[target->_count] = toShare[j];
-                                        ++target->_count;
-                                        --shareCount;
-                                        toShare[j] = toShare[shareCount];
-                                    } else {
-                                        ++j;
-                                    }
-                                }
+                        }
+                    }
+                    // Interior nodes do not hold elements.
+                    _allocator->release(_elements, footprint());
+                    _elements = nullptr;
+                    _count = dimension;
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                void Node<K, R, E, A, G>::merge() {
+                    unsigned int count = _count;
+                    _elements = slots();
+                    K* mergedKeys = keys();
+                    _count = 0;
+                    for(unsigned int i = 0; i < count; ++i) {
+                        Node<K, R, E, A, G>* target = _nodes + i;
+                        unsigned int toRetrieve = target->_count;
+                        const K* targetKeys = target->keys();
+                        for(unsigned int j = 0; j < toRetrieve; ++j) {
+                            _elements[_count] = target->_elements[j];
+                            mergedKeys[_count] = targetKeys[j];
+                            ++_count;
+                        }
+                        // The sub-node is kept for later splits, its slots are not.
+                        _allocator->release(target->_elements, footprint());
+                        target->_elements = nullptr;
+                        target->_count = 0;
+                    }
+                    _leaf = true;
+                    ++_state->merges;
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                void Node<K, R, E, A, G>::retire() {
+                    if(_leaf) {
+                        if(nullptr != _elements) {
+                            _allocator->release(_elements, footprint());
+                            _elements = nullptr;
+                        }
+                    } else {
+                        for(unsigned int i = 0; i < _count; ++i) {
+                            _nodes[i].retire();
+                        }
+                        _leaf = true;
+                    }
+                    _count = 0;
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                void Node<K, R, E, A, G>::collapse() {
+                    if(!_leaf) {
+                        for(unsigned int i = 0; i < _count; ++i) {
+                            _nodes[i].retire();
+                        }
+                        _leaf = true;
+                    }
+                    if(nullptr == _elements) {
+                        _elements = slots();
+                    }
+                    _count = 0;
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                void Node<K, R, E, A, G>::fill(E** elements, unsigned int count) {
+                    typedef std::integral_constant<bool, Indexable<R, K>::value> Indexed;
+                    if(count <= _cardinality) {
+                        collapse();
+                        K* cache = keys();
+                        for(unsigned int i = 0; i < count; ++i) {
+                            _elements[i] = elements[i];
+                            cache[i] = elements[i]->key();
+                        }
+                        _count = count;
+                    } else {
+                        if(_leaf) {
+                            if(nullptr == _nodes) {
+                                subdivide();
                             }
-                            node->_count = dimension;
-                            for(unsigned int i = 0; i < dimension; ++i) {
-                                target = node->_nodes[i];
-                                if(target->_region->contains(key)) {
-                                    node = target;
-                                    break;
+                            if(nullptr != _elements) {
+                                _allocator->release(_elements, footprint());
+                                _elements = nullptr;
+                            }
+                            _leaf = false;
+                        }
+                        // In-place partitioning. As for 'find', an element belongs
+                        // to the first sub-node containing it.
+                        unsigned int dimension = fanout();
+                        E** begin = elements;
+                        E** end = elements + count;
+                        for(unsigned int i = 0; i < dimension; ++i) {
+                            Node<K, R, E, A, G>* target = _nodes + i;
+                            E** cur = begin;
+                            for(E** it = begin; it < end; ++it) {
+                                if(owns(i, (*it)->key(), Indexed())) {
+                                    E* swap = *cur;
+                                    *cur = *it;
+                                    *it = swap;
+                                    ++cur;
                                 }
                             }
+                            target->fill(begin, cur - begin);
+                            begin = cur;
                         }
+                        _count = dimension;
+                    }
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                void Node<K, R, E, A, G>::build(E** elements, unsigned int count) {
+                    // Discard elements out of the tree region.
+                    unsigned int inside = 0;
+                    for(unsigned int i = 0; i < count; ++i) {
+                        if(_region->contains(elements[i]->key())) {
+                            E* swap = elements[inside];
+                            elements[inside] = elements[i];
+                            elements[i] = swap;
+                            ++inside;
+                        }
+                    }
+                    fill(elements, inside);
+                    if(Aggregated) {
+                        refresh();
+                    }
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                Node<K, R, E, A, G>* Node<K, R, E, A, G>::add(E* element) {
+                    typedef std::integral_constant<bool, Indexable<R, K>::value> Indexed;
+                    const K& key = element->key();
+                    Node<K, R, E, A, G>* node = find(key);
+                    while(nullptr != node && _cardinality == node->_count) {
+                        node->split();
+                        node = node->child(key, Indexed());
+                    }
+                    if(nullptr != node) {
                         node->_elements[node->_count] = element;
+                        node->keys()[node->_count] = key;
                         ++node->_count;
+                        node->enter(key, element);
                     }
+                    return node;
                 }
 
-            template <typename K, typename R, typename E>
-                void Node<K, R, E>::remove(E* element) {
+            template <typename K, typename R, typename E, typename A, typename G>
+                Node<K, R, E, A, G>* Node<K, R, E, A, G>::locate(E* element, unsigned int& slot) {
+                    Node<K, R, E, A, G>* result = nullptr;
                     const K& key = element->key();
-                    Node<K, R, E>* node = find(key);
-                    if(nullptr != node) {
-                        unsigned int count = node->_count;
-                        E** elements = node->_elements;
-                        for(unsigned int i = 0; i < count; ++i, ++elements) {
-                            if(element == (*elements)) {
-                                --node->_count;
-                                *elements = node->_elements[node->_count];
-                                break;
+                    if(_region->contains(key)) {
+                        if(_leaf) {
+                            for(unsigned int i = 0; i < _count; ++i) {
+                                if(element == _elements[i]) {
+                                    slot = i;
+                                    result = this;
+                                    break;
+                                }
+                            }
+                        } else {
+                            for(unsigned int i = 0; i < _count && nullptr == result; ++i) {
+                                result = _nodes[i].locate(element, slot);
                             }
                         }
+                    }
+                    return result;
+                }
 
-                        while(nullptr != node->_parent) {
-                            node = node->_parent;
-                            unsigned int global = 0;
-                            unsigned int count = node->_count;
-                            for(unsigned int i = 0; i < count; ++i) {
-                                if(node->_nodes[i]->_leaf) {
-                                    global += node->_nodes[i]->_count;
-                                } else {
-                                    global += _cardinality + 1;
-                                }
-                            }
-                            if(global <= _cardinality) {
-                                node->_leaf = true;
-                                node->_count = 0;
-                                for(unsigned int i = 0; i < count; ++i) {
-                                    Node<K, R, E>* target = node->_nodes[i];
-                                    unsigned int toRetrieve = target->_count;
-                                    for(unsigned int j = 0; j < toRetrieve; ++j) {
-                                        node->_elements[node->_count] = target->_elements[j];
-                                        ++node->_count;
-                                    }
-                                }
+            template <typename K, typename R, typename E, typename A, typename G>
+                Node<K, R, E, A, G>* Node<K, R, E, A, G>::cascade(Node<K, R, E, A, G>* node) {
+                    Node<K, R, E, A, G>* result = node;
+                    while(!_state->deferred && nullptr != node->_parent) {
+                        node = node->_parent;
+                        unsigned int global = 0;
+                        unsigned int count = node->_count;
+                        for(unsigned int i = 0; i < count; ++i) {
+                            if(node->_nodes[i]._leaf) {
+                                global += node->_nodes[i]._count;
                             } else {
+                                global += _cardinality + 1;
+                            }
+                        }
+                        if(global <= _state->threshold) {
+                            node->merge();
+                            result = node;
+                        } else {
+                            break;
+                        }
+                    }
+                    return result;
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                unsigned int Node<K, R, E, A, G>::rebalance(unsigned int threshold) {
+                    unsigned int result;
+                    if(_leaf) {
+                        result = _count;
+                    } else {
+                        result = 0;
+                        bool leaves = true;
+                        for(unsigned int i = 0; i < _count; ++i) {
+                            result += _nodes[i].rebalance(threshold);
+                            leaves = leaves && _nodes[i]._leaf;
+                        }
+                        if(leaves && result <= threshold) {
+                            merge();
+                        }
+                    }
+                    return result;
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                void Node<K, R, E, A, G>::policy(unsigned int threshold, bool deferred) {
+                    _state->threshold = threshold < _cardinality ? threshold : _cardinality;
+                    _state->deferred = deferred;
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                void Node<K, R, E, A, G>::compact() {
+                    rebalance(_cardinality);
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                bool Node<K, R, E, A, G>::holds(E* element, unsigned int& slot) const {
+                    bool result = false;
+                    if(_leaf) {
+                        for(unsigned int i = 0; i < _count; ++i) {
+                            if(element == _elements[i]) {
+                                slot = i;
+                                result = true;
                                 break;
                             }
                         }
                     }
+                    return result;
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                void Node<K, R, E, A, G>::remove(E* element) {
+                    remove(element, nullptr);
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                void Node<K, R, E, A, G>::remove(E* element, Node<K, R, E, A, G>* leaf) {
+                    unsigned int slot;
+                    Node<K, R, E, A, G>* node = (nullptr != leaf && leaf->holds(element, slot)) ?
+                        leaf : locate(element, slot);
+                    if(nullptr != node) {
+                        node->leave(node->keys()[slot], element);
+                        --node->_count;
+                        node->_elements[slot] = node->_elements[node->_count];
+                        node->keys()[slot] = node->keys()[node->_count];
+                        cascade(node);
+                    }
                 }
 
-            template <typename K, typename R, typename E>
-                void Node<K, R, E>::move(E* element, K& key) {
-                    K elementKey = element->key();
-                    Node<K, R, E>* sourceNode = find(elementKey);
-                    Node<K, R, E>* destinationNode = find(key);
-                    if(destinationNode != sourceNode) {
-                        sourceNode->remove(element);
+            template <typename K, typename R, typename E, typename A, typename G>
+                void Node<K, R, E, A, G>::move(E* element, K& key) {
+                    Node<K, R, E, A, G>* leaf = nullptr;
+                    move(element, key, leaf);
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                void Node<K, R, E, A, G>::move(E* element, K& key, Node<K, R, E, A, G>*& leaf) {
+                    unsigned int slot;
+                    Node<K, R, E, A, G>* source = (nullptr != leaf && leaf->holds(element, slot)) ?
+                        leaf : locate(element, slot);
+                    if(nullptr != source && source->_region->contains(key)) {
+                        // Still in its leaf.
+                        source->leave(source->keys()[slot], element);
                         element->key(key);
-                        destinationNode->add(element);
+                        source->keys()[slot] = key;
+                        source->enter(key, element);
+                        leaf = source;
                     } else {
+                        Node<K, R, E, A, G>* target = this;
+                        if(nullptr != source) {
+                            source->leave(source->keys()[slot], element);
+                            --source->_count;
+                            source->_elements[slot] = source->_elements[source->_count];
+                            source->keys()[slot] = source->keys()[source->_count];
+                            // Merges may take the source leaf away. Start from what
+                            // replaces it and walk up to the lowest common ancestor.
+                            target = cascade(source);
+                            while(nullptr != target && !target->_region->contains(key)) {
+                                target = target->_parent;
+                            }
+                        }
                         element->key(key);
+                        leaf = (nullptr != target) ? target->add(element) : nullptr;
                     }
                 }
 
-            template <typename K, typename R, typename E>
+            template <typename K, typename R, typename E, typename A, typename G>
+                void Node<K, R, E, A, G>::moveAll(E** elements, K* keys, unsigned int count,
+                        Node<K, R, E, A, G>** leaves) {
+                    // Relocation targets and the indices of the relocated elements.
+                    std::size_t size = count * (sizeof(Node<K, R, E, A, G>*) + sizeof(unsigned int));
+                    Node<K, R, E, A, G>** targets = static_cast<Node<K, R, E, A, G>**>(_allocator->acquire(size));
+                    unsigned int* pending = reinterpret_cast<unsigned int*>(targets + count);
+                    unsigned int moving = 0;
+                    // Update keys, detaching the elements leaving their leaf. No merge
+                    // occurs, so the ancestors of the source leaves stay valid targets.
+                    for(unsigned int i = 0; i < count; ++i) {
+                        E* element = elements[i];
+                        K& key = keys[i];
+                        unsigned int slot;
+                        Node<K, R, E, A, G>* source = (nullptr != leaves && nullptr != leaves[i]
+                                && leaves[i]->holds(element, slot)) ? leaves[i] : locate(element, slot);
+                        if(nullptr != source && source->_region->contains(key)) {
+                            source->leave(source->keys()[slot], element);
+                            source->keys()[slot] = key;
+                            source->enter(key, element);
+                            if(nullptr != leaves) {
+                                leaves[i] = source;
+                            }
+                        } else {
+                            Node<K, R, E, A, G>* target = this;
+                            if(nullptr != source) {
+                                source->leave(source->keys()[slot], element);
+                                --source->_count;
+                                source->_elements[slot] = source->_elements[source->_count];
+                                source->keys()[slot] = source->keys()[source->_count];
+                                target = source->_parent;
+                                while(nullptr != target && !target->_region->contains(key)) {
+                                    target = target->_parent;
+                                }
+                            }
+                            targets[moving] = target;
+                            pending[moving] = i;
+                            ++moving;
+                        }
+                        element->key(key);
+                    }
+                    // Relocate them.
+                    for(unsigned int i = 0; i < moving; ++i) {
+                        unsigned int index = pending[i];
+                        Node<K, R, E, A, G>* leaf = (nullptr != targets[i]) ?
+                            targets[i]->add(elements[index]) : nullptr;
+                        if(nullptr != leaves) {
+                            leaves[index] = leaf;
+                        }
+                    }
+                    if(moving > 0 && !_state->deferred) {
+                        // Stale handles are detected on the next move.
+                        rebalance(_state->threshold);
+                    }
+                    _allocator->release(targets, size);
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
                 template <typename S, typename V>
-                unsigned int Node<K, R, E>::retrieve(const S& func, E** buffer, unsigned int size, V* visitor) const {
-                    unsigned int result;
+                unsigned int Node<K, R, E, A, G>::retrieve(const S& func, E** buffer, unsigned int size,
+                        V* visitor, bool* overflow) const {
+                    Collector<E> collector(buffer, size);
+                    retrieve(func, collector, visitor);
+                    if(nullptr != overflow) {
+                        *overflow = collector.overflow();
+                    }
+                    return collector.count();
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                template <typename S, typename C, typename V>
+                bool Node<K, R, E, A, G>::retrieve(const S& func, C& sink, V* visitor) const {
+                    bool result = true;
                     if(nullptr != visitor) {
                         visitor->enter(*_region);
                     }
@@ -326,42 +1405,24 @@ namespace Headless {
                         // 1. This leaf intersects with the search function.
                         // 2. This leaf is the root node and might not be relevant ...
                         // In all case, we must confront all the elements to 'func'.
-                        unsigned int max = size < _count ? size : _count;
-                        E** dest = buffer;
-                        E** cur = _elements;
-                        result = 0;
-                        for(unsigned int i = 0; i < max; ++i, ++cur) {
-                            if(func.contains((*cur)->key())) {
-                                if(nullptr != visitor) {
-                                    visitor->inspect(*cur);
-                                }
-                                *dest = *cur;
-                                ++dest;
-                                ++result;
-                            }
-                        }
+                        result = scan(func, sink, visitor,
+                                std::integral_constant<bool, Batched<S, K>::value>());
                     } else {
                         // We're in a node.
                         // Let's test all the subs against the 'func'. In some cases,
                         // fetch the whole sub-tree, in other cases, just recurse the retrieval.
-                        E** dest = buffer;
-                        unsigned int remaining = size;
-                        unsigned int retrieved;
                         int intersects;
-                        Node<K, R, E>** nodes = _nodes;
-                        for(unsigned int i = 0; i < _count; ++i, ++nodes) {
-                            intersects = func.contains(*((*nodes)->_region));
+                        const Node<K, R, E, A, G>* node = _nodes;
+                        for(unsigned int i = 0; i < _count && result; ++i, ++node) {
+                            intersects = func.contains(*(node->_region));
                             if(intersects >= 0) {
                                 if(intersects != 0) {
-                                    retrieved = (*nodes)->fetch(dest, remaining, visitor);
+                                    result = node->fetch(sink, visitor);
                                 } else {
-                                    retrieved = (*nodes)->retrieve(func, dest, remaining, visitor);
+                                    result = node->retrieve(func, sink, visitor);
                                 }
-                                remaining -= retrieved;
-                                dest += retrieved;
                             }
                         }
-                        result = size - remaining;
                     }
                     if(nullptr != visitor) {
                         visitor->exit(*_region);
@@ -369,35 +1430,276 @@ namespace Headless {
                     return result;
                 }
 
-            template <typename K, typename R, typename E>
-                template <typename V>
-                unsigned int Node<K, R, E>::fetch(E** buffer, unsigned int size, V* visitor) const {
+            template <typename K, typename R, typename E, typename A, typename G>
+                template <typename Q, typename C>
+                void Node<K, R, E, A, G>::retrieveAll(const Q& queries, unsigned int count,
+                        unsigned int size, C& consumer) const {
+                    // The allocator is not shared among threads, buffers come from the heap.
+                    #pragma omp parallel
+                    {
+                        E** buffer = new E*[size];
+                        #pragma omp for schedule(dynamic, BATCH_CHUNK_SIZE)
+                        for(unsigned int i = 0; i < count; ++i) {
+                            unsigned int retrieved = retrieve(queries(i), buffer, size);
+                            consumer(i, buffer, retrieved);
+                        }
+                        delete []buffer;
+                    }
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                template <typename N, typename C>
+                void Node<K, R, E, A, G>::pairs(const N& proximity, C& kernel) const {
+                    pairs(this, proximity, kernel);
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                template <typename N, typename C>
+                void Node<K, R, E, A, G>::pairs(const Node<K, R, E, A, G>* other,
+                        const N& proximity, C& kernel) const {
+                    if(this == other) {
+                        if(_leaf) {
+                            if(_count > 0) {
+                                kernel(_elements, keys(), _count, _elements, keys(), _count);
+                            }
+                        } else {
+                            // Each sub-tree with itself, then with the following ones.
+                            for(unsigned int i = 0; i < _count; ++i) {
+                                const Node<K, R, E, A, G>* node = _nodes + i;
+                                node->pairs(node, proximity, kernel);
+                                for(unsigned int j = i + 1; j < _count; ++j) {
+                                    const Node<K, R, E, A, G>* next = _nodes + j;
+                                    if(proximity.near(*node->_region, *next->_region)) {
+                                        node->pairs(next, proximity, kernel);
+                                    }
+                                }
+                            }
+                        }
+                    } else if(_leaf && other->_leaf) {
+                        if(_count > 0 && other->_count > 0) {
+                            kernel(_elements, keys(), _count,
+                                    other->_elements, other->keys(), other->_count);
+                        }
+                    } else if(_leaf) {
+                        for(unsigned int i = 0; i < other->_count; ++i) {
+                            const Node<K, R, E, A, G>* node = other->_nodes + i;
+                            if(proximity.near(*_region, *node->_region)) {
+                                pairs(node, proximity, kernel);
+                            }
+                        }
+                    } else {
+                        for(unsigned int i = 0; i < _count; ++i) {
+                            const Node<K, R, E, A, G>* node = _nodes + i;
+                            if(proximity.near(*node->_region, *other->_region)) {
+                                node->pairs(other, proximity, kernel);
+                            }
+                        }
+                    }
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                template <typename S, typename O, typename C>
+                bool Node<K, R, E, A, G>::approximate(const S& func, const O& criterion, C& sink) const {
+                    bool result = true;
+                    if(_leaf) {
+                        const K* cache = keys();
+                        for(unsigned int i = 0; i < _count && result; ++i) {
+                            if(func.contains(cache[i])) {
+                                result = sink(_elements[i]);
+                            }
+                        }
+                    } else {
+                        const Node<K, R, E, A, G>* node = _nodes;
+                        for(unsigned int i = 0; i < _count && result; ++i, ++node) {
+                            // Empty sub-trees have nothing to summarize.
+                            if((node->_leaf && 0 == node->_count) || func.contains(*(node->_region)) < 0) {
+                                continue;
+                            }
+                            if(criterion.open(*(node->_region), node->_aggregate)) {
+                                result = node->approximate(func, criterion, sink);
+                            } else {
+                                result = sink(*(node->_region), node->_aggregate);
+                            }
+                        }
+                    }
+                    return result;
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                void Node<K, R, E, A, G>::refresh() {
+                    _aggregate.clear();
+                    if(_leaf) {
+                        const K* cache = keys();
+                        for(unsigned int i = 0; i < _count; ++i) {
+                            _aggregate.add(cache[i], _elements[i]);
+                        }
+                    } else {
+                        for(unsigned int i = 0; i < _count; ++i) {
+                            _nodes[i].refresh();
+                            _aggregate.add(_nodes[i]._aggregate);
+                        }
+                    }
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                template <typename D>
+                unsigned int Node<K, R, E, A, G>::nearest(const K& key, unsigned int k, E** buffer,
+                        const D& metric, double* distances) const {
+                    typedef std::pair<double, const Node<K, R, E, A, G>*> Entry;
+                    typedef std::integral_constant<bool, Measurable<R, K>::value> Bounded;
+                    double* heap = (nullptr != distances) ? distances : new double[k];
+                    unsigned int count = 0;
+                    // Nodes to open, nearest first.
+                    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > queue;
+                    if(k > 0) {
+                        queue.push(Entry(bound(key, Bounded()), this));
+                    }
+                    while(!queue.empty()) {
+                        Entry entry = queue.top();
+                        queue.pop();
+                        if(count == k && entry.first >= heap[0]) {
+                            // Nothing closer remains.
+                            break;
+                        }
+                        const Node<K, R, E, A, G>* node = entry.second;
+                        if(node->_leaf) {
+                            for(unsigned int i = 0; i < node->_count; ++i) {
+                                E* element = node->_elements[i];
+                                double distance = metric.distance(key, node->keys()[i]);
+                                unsigned int cur;
+                                if(count < k) {
+                                    // Sift up in the result max-heap.
+                                    cur = count;
+                                    ++count;
+                                    while(cur > 0 && heap[(cur - 1) / 2] < distance) {
+                                        heap[cur] = heap[(cur - 1) / 2];
+                                        buffer[cur] = buffer[(cur - 1) / 2];
+                                        cur = (cur - 1) / 2;
+                                    }
+                                } else if(distance < heap[0]) {
+                                    // Replace the farthest and sift down.
+                                    cur = 0;
+                                    for(;;) {
+                                        unsigned int child = 2 * cur + 1;
+                                        if(child >= count) {
+                                            break;
+                                        }
+                                        if(child + 1 < count && heap[child + 1] > heap[child]) {
+                                            ++child;
+                                        }
+                                        if(heap[child] <= distance) {
+                                            break;
+                                        }
+                                        heap[cur] = heap[child];
+                                        buffer[cur] = buffer[child];
+                                        cur = child;
+                                    }
+                                } else {
+                                    continue;
+                                }
+                                heap[cur] = distance;
+                                buffer[cur] = element;
+                            }
+                        } else {
+                            for(unsigned int i = 0; i < node->_count; ++i) {
+                                const Node<K, R, E, A, G>* sub = node->_nodes + i;
+                                double distance = sub->bound(key, Bounded());
+                                if(count < k || distance < heap[0]) {
+                                    queue.push(Entry(distance, sub));
+                                }
+                            }
+                        }
+                    }
+                    // Heap sort, farthest elements go last.
+                    for(unsigned int end = count; end > 1;) {
+                        --end;
+                        double distance = heap[end];
+                        E* element = buffer[end];
+                        heap[end] = heap[0];
+                        buffer[end] = buffer[0];
+                        unsigned int cur = 0;
+                        for(;;) {
+                            unsigned int child = 2 * cur + 1;
+                            if(child >= end) {
+                                break;
+                            }
+                            if(child + 1 < end && heap[child + 1] > heap[child]) {
+                                ++child;
+                            }
+                            if(heap[child] <= distance) {
+                                break;
+                            }
+                            heap[cur] = heap[child];
+                            buffer[cur] = buffer[child];
+                            cur = child;
+                        }
+                        heap[cur] = distance;
+                        buffer[cur] = element;
+                    }
+                    if(nullptr == distances) {
+                        delete []heap;
+                    }
+                    return count;
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                template <typename S, typename C, typename V>
+                bool Node<K, R, E, A, G>::scan(const S& func, C& sink, V* visitor, std::false_type) const {
+                    bool result = true;
+                    const K* key = keys();
+                    for(unsigned int i = 0; i < _count && result; ++i, ++key) {
+                        if(func.contains(*key)) {
+                            if(nullptr != visitor) {
+                                visitor->inspect(_elements[i]);
+                            }
+                            result = sink(_elements[i]);
+                        }
+                    }
+                    return result;
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                template <typename S, typename C, typename V>
+                bool Node<K, R, E, A, G>::scan(const S& func, C& sink, V* visitor, std::true_type) const {
+                    bool result = true;
+                    unsigned char mask[SCAN_BLOCK_SIZE];
+                    const K* cache = keys();
+                    for(unsigned int start = 0; start < _count && result; start += SCAN_BLOCK_SIZE) {
+                        unsigned int block = _count - start < SCAN_BLOCK_SIZE ? _count - start : SCAN_BLOCK_SIZE;
+                        func.contains(cache + start, block, mask);
+                        for(unsigned int i = 0; i < block && result; ++i) {
+                            if(0 != mask[i]) {
+                                E* element = _elements[start + i];
+                                if(nullptr != visitor) {
+                                    visitor->inspect(element);
+                                }
+                                result = sink(element);
+                            }
+                        }
+                    }
+                    return result;
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                template <typename C, typename V>
+                bool Node<K, R, E, A, G>::fetch(C& sink, V* visitor) const {
                     if(nullptr != visitor) {
                         visitor->enter(*_region);
                     }
-                    unsigned int result;
+                    bool result = true;
                     if(_leaf) {
                         if(nullptr != visitor) {
                             visitor->inspect(_elements, _count);
                         }
                         // Get all the elements.
-                        result = size < _count ? size : _count;
-                        E** dest = buffer;
                         E** src = _elements;
-                        for(unsigned int i = 0; i < result; ++i, ++dest, ++src) {
-                            *dest = *src;
+                        for(unsigned int i = 0; i < _count && result; ++i, ++src) {
+                            result = sink(*src);
                         }
                     } else {
-                        result = 0;
-                        E** dest = buffer;
-                        unsigned int remaining = size;
-                        unsigned int retrieved;
-                        for(unsigned int i = 0; i < _count; ++i) {
-                            retrieved = _nodes[i]->fetch(dest, remaining);
-                            remaining -= retrieved;
-                            dest += retrieved;
+                        for(unsigned int i = 0; i < _count && result; ++i) {
+                            result = _nodes[i].fetch(sink, visitor);
                         }
-                        result = size - remaining;
                     }
                     if(nullptr != visitor) {
                         visitor->exit(*_region);
@@ -405,29 +1707,78 @@ namespace Headless {
                     return result;
                 }
 
-            template <typename K, typename R, typename E>
+            template <typename K, typename R, typename E, typename A, typename G>
                 template <typename V>
-                void Node<K, R, E>::visit(V &visitor) {
+                void Node<K, R, E, A, G>::visit(V &visitor) {
                     visitor.enter(*_region);
                     if(_leaf) {
                         visitor.inspect(_elements, _count);
                     } else {
                         for(unsigned int i = 0; i < _count; ++i) {
-                            _nodes[i]->visit(visitor);
+                            _nodes[i].visit(visitor);
                         }
                     }
                     visitor.exit(*_region);
                 }
 
+            template <typename K, typename R, typename E, typename A, typename G>
+                Statistics Node<K, R, E, A, G>::statistics() const {
+                    Statistics result;
+                    result.nodes = 0;
+                    result.leaves = 0;
+                    result.elements = 0;
+                    result.maxDepth = 0;
+                    result.fill.assign(_cardinality + 1, 0);
+                    double depthSum = 0.0;
+                    gather(result, 1, depthSum);
+                    result.averageDepth = result.elements > 0 ? depthSum / result.elements : 0.0;
+                    result.bytes = bytes() + ((nullptr == _parent) ? sizeof(State) : 0);
+                    result.splits = _state->splits;
+                    result.merges = _state->merges;
+                    return result;
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                void Node<K, R, E, A, G>::gather(Statistics& statistics, unsigned int depth,
+                        double& depthSum) const {
+                    ++statistics.nodes;
+                    if(_leaf) {
+                        ++statistics.leaves;
+                        statistics.elements += _count;
+                        ++statistics.fill[_count];
+                        depthSum += static_cast<double>(depth) * _count;
+                        if(depth > statistics.maxDepth) {
+                            statistics.maxDepth = depth;
+                        }
+                    } else {
+                        for(unsigned int i = 0; i < _count; ++i) {
+                            _nodes[i].gather(statistics, depth + 1, depthSum);
+                        }
+                    }
+                }
+
+            template <typename K, typename R, typename E, typename A, typename G>
+                std::size_t Node<K, R, E, A, G>::bytes() const {
+                    std::size_t result = (nullptr != _elements) ? footprint() : 0;
+                    if(nullptr != _nodes) {
+                        unsigned int dimension = fanout();
+                        result += dimension * (sizeof(Node<K, R, E, A, G>) + sizeof(R));
+                        for(unsigned int i = 0; i < dimension; ++i) {
+                            result += _nodes[i].bytes();
+                        }
+                    }
+                    return result;
+                }
+
 #ifdef TREE_DEBUG
-            template <typename K, typename R, typename E>
+            template <typename K, typename R, typename E, typename A, typename G>
                 template <typename V>
-                void Node<K, R, E>::deepVisit(V &visitor) {
+                void Node<K, R, E, A, G>::deepVisit(V &visitor) {
                     visitor.visit(this, _region, _elements, _nodes, _parent, _leaf, _count, _cardinality);
                     if(_nodes) {
-                        unsigned int dimension = _region->dimension();
+                        unsigned int dimension = fanout();
                         for(unsigned int i = 0; i < dimension; ++i) {
-                            _nodes[i]->deepVisit(visitor);
+                            _nodes[i].deepVisit(visitor);
                         }
                     }
                 }